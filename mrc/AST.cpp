@@ -1,7 +1,304 @@
 #include "AST.h"
 
-#include <memory>
+#include <cassert>
 
-std::unique_ptr<llvm::Value> LiteralExprAST::codegen() {
-	return nullptr;
-};
+bool is_assignment(Operation op) {
+  return op >= Operation::Assign && op <= Operation::ShrAssign;
+}
+
+Operation get_compound_operation(Operation op) {
+  switch (op) {
+  case Operation::AddAssign:
+    return Operation::Add;
+  case Operation::SubAssign:
+    return Operation::Sub;
+  case Operation::MulAssign:
+    return Operation::Mul;
+  case Operation::DivAssign:
+    return Operation::Div;
+  case Operation::RemAssign:
+    return Operation::Rem;
+  case Operation::BitAndAssign:
+    return Operation::BitAnd;
+  case Operation::BitOrAssign:
+    return Operation::BitOr;
+  case Operation::ShlAssign:
+    return Operation::Shl;
+  case Operation::ShrAssign:
+    return Operation::Shr;
+  default:
+    assert(false && "not a compound assignment");
+    return op;
+  }
+}
+
+NodeId Ast::add(NodeKind kind, Operation op, uint32_t offset, Data data) {
+  const NodeId node(this->size());
+  assert(node.is_valid() && "AST node space exhausted");
+  this->kinds.push_back(kind);
+  this->ops.push_back(op);
+  this->offsets.push_back(offset);
+  this->data.push_back(data);
+  return node;
+}
+
+void Ast::set(NodeId node, NodeKind kind, Operation op, Data data) {
+  this->kinds[node.get_raw()] = kind;
+  this->ops[node.get_raw()] = op;
+  this->data[node.get_raw()] = data;
+}
+
+Ast::Data Ast::split(uint64_t value) {
+  return {static_cast<uint32_t>(value), static_cast<uint32_t>(value >> 32)};
+}
+
+uint64_t Ast::join(NodeId node) const {
+  const Data &data = this->data[node.get_raw()];
+  return static_cast<uint64_t>(data.rhs) << 32 | data.lhs;
+}
+
+NodeId Ast::add_literal(const Token &token, const Lexer &lexer) {
+  switch (token.kind) {
+  case TokenKind::Numeric: {
+    const NumericValue &value = lexer.get_numeric(token);
+    switch (value.kind) {
+    case NumericValue::Integer:
+      return this->add_integer(token.offset, value.get_integer());
+    case NumericValue::WideInteger: {
+      // Literals are never negative; the extra bit keeps the sign clear.
+      const llvm::APInt &wide = lexer.get_wide_integer(value);
+      return this->add_wide_integer(token.offset,
+                                    wide.zext(wide.getBitWidth() + 1));
+    }
+    case NumericValue::Float:
+      return this->add_float(token.offset, value.get_float());
+    }
+    return NodeId();
+  }
+  case TokenKind::String:
+    return this->add_string(token.offset, token.payload);
+  case TokenKind::True:
+    return this->add_bool(token.offset, true);
+  case TokenKind::False:
+    return this->add_bool(token.offset, false);
+  case TokenKind::Identifier:
+    return this->add_identifier(token.offset, Symbol(token.payload));
+  default:
+    assert(false && "token is not a literal");
+    return NodeId();
+  }
+}
+
+NodeId Ast::add_integer(uint32_t offset, uint64_t value) {
+  return this->add(NodeKind::IntegerLiteral, Operation(), offset,
+                   split(value));
+}
+
+// Returns the index of `value` in the wide integer table.
+uint32_t Ast::add_wide(const llvm::APInt &value) {
+  this->wide_integers.push_back({value.getBitWidth(), this->words.size()});
+  this->words.append(value.getRawData(), value.getNumWords());
+  return this->wide_integers.size() - 1;
+}
+
+NodeId Ast::add_wide_integer(uint32_t offset, const llvm::APInt &value) {
+  return this->add(NodeKind::WideIntegerLiteral, Operation(), offset,
+                   {this->add_wide(value), 0});
+}
+
+NodeId Ast::add_float(uint32_t offset, double value) {
+  return this->add(NodeKind::FloatLiteral, Operation(), offset,
+                   split(llvm::bit_cast<uint64_t>(value)));
+}
+
+NodeId Ast::add_string(uint32_t offset, uint32_t string_index) {
+  return this->add(NodeKind::StringLiteral, Operation(), offset,
+                   {string_index, 0});
+}
+
+NodeId Ast::add_bool(uint32_t offset, bool value) {
+  return this->add(NodeKind::BoolLiteral, Operation(), offset,
+                   {value ? 1u : 0u, 0});
+}
+
+NodeId Ast::add_identifier(uint32_t offset, Symbol symbol) {
+  return this->add(NodeKind::Identifier, Operation(), offset,
+                   {symbol.get_raw(), 0});
+}
+
+NodeId Ast::add_unary(uint32_t offset, Operation op, NodeId operand) {
+  return this->add(NodeKind::Unary, op, offset, {operand.get_raw(), 0});
+}
+
+NodeId Ast::add_binary(uint32_t offset, Operation op, NodeId lhs,
+                       NodeId rhs) {
+  return this->add(NodeKind::Binary, op, offset,
+                   {lhs.get_raw(), rhs.get_raw()});
+}
+
+NodeId Ast::add_list(uint32_t offset, llvm::ArrayRef<NodeId> items) {
+  const uint32_t start = this->extra.size();
+  this->extra.append(items.data(), static_cast<uint32_t>(items.size()));
+  return this->add(NodeKind::List, Operation(), offset,
+                   {start, static_cast<uint32_t>(items.size())});
+}
+
+NodeId Ast::add_let(uint32_t offset, Symbol name, NodeId init) {
+  return this->add(NodeKind::Let, Operation(), offset,
+                   {name.get_raw(), init.get_raw()});
+}
+
+NodeId Ast::add_path(uint32_t offset, Symbol module, Symbol name) {
+  return this->add(NodeKind::Path, Operation(), offset,
+                   {module.get_raw(), name.get_raw()});
+}
+
+NodeId Ast::add_block(uint32_t offset, llvm::ArrayRef<NodeId> statements) {
+  const uint32_t start = this->extra.size();
+  this->extra.append(statements.data(),
+                     static_cast<uint32_t>(statements.size()));
+  return this->add(NodeKind::Block, Operation(), offset,
+                   {start, static_cast<uint32_t>(statements.size())});
+}
+
+NodeId Ast::add_alias(uint32_t offset, Symbol name, NodeId target) {
+  return this->add(NodeKind::Alias, Operation(), offset,
+                   {name.get_raw(), target.get_raw()});
+}
+
+void Ast::set_integer(NodeId node, uint64_t value) {
+  this->set(node, NodeKind::IntegerLiteral, Operation(), split(value));
+}
+
+void Ast::set_wide_integer(NodeId node, const llvm::APInt &value) {
+  this->set(node, NodeKind::WideIntegerLiteral, Operation(),
+            {this->add_wide(value), 0});
+}
+
+void Ast::set_float(NodeId node, double value) {
+  this->set(node, NodeKind::FloatLiteral, Operation(),
+            split(llvm::bit_cast<uint64_t>(value)));
+}
+
+void Ast::set_bool(NodeId node, bool value) {
+  this->set(node, NodeKind::BoolLiteral, Operation(), {value ? 1u : 0u, 0});
+}
+
+void Ast::replace(NodeId node, NodeId with) {
+  this->set(node, this->get_kind(with), this->get_op(with),
+            this->data[with.get_raw()]);
+}
+
+void Ast::set_declaration(NodeId identifier, uint32_t declaration) {
+  assert(this->get_kind(identifier) == NodeKind::Identifier);
+  this->data[identifier.get_raw()].rhs = declaration;
+}
+
+void Ast::reserve(uint32_t nodes) {
+  this->kinds.reserve(nodes);
+  this->ops.reserve(nodes);
+  this->offsets.reserve(nodes);
+  this->data.reserve(nodes);
+}
+
+void Ast::clear() {
+  this->kinds.clear();
+  this->ops.clear();
+  this->offsets.clear();
+  this->data.clear();
+  this->extra.clear();
+  this->wide_integers.clear();
+  this->words.clear();
+  this->names.clear();
+}
+
+NodeId Ast::get_lhs(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Binary);
+  return NodeId(this->data[node.get_raw()].lhs);
+}
+
+NodeId Ast::get_rhs(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Binary);
+  return NodeId(this->data[node.get_raw()].rhs);
+}
+
+NodeId Ast::get_operand(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Unary);
+  return NodeId(this->data[node.get_raw()].lhs);
+}
+
+uint64_t Ast::get_integer(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::IntegerLiteral);
+  return this->join(node);
+}
+
+llvm::APInt Ast::get_wide_integer(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::WideIntegerLiteral);
+  const WideInteger &wide =
+      this->wide_integers[this->data[node.get_raw()].lhs];
+  return llvm::APInt(wide.bit_width,
+                     llvm::ArrayRef<uint64_t>(&this->words[wide.word],
+                                              (wide.bit_width + 63) / 64));
+}
+
+double Ast::get_float(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::FloatLiteral);
+  return llvm::bit_cast<double>(this->join(node));
+}
+
+uint32_t Ast::get_string_index(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::StringLiteral);
+  return this->data[node.get_raw()].lhs;
+}
+
+bool Ast::get_bool(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::BoolLiteral);
+  return this->data[node.get_raw()].lhs != 0;
+}
+
+Symbol Ast::get_symbol(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Identifier);
+  return this->get_name(this->data[node.get_raw()].lhs);
+}
+
+uint32_t Ast::get_declaration(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Identifier);
+  return this->data[node.get_raw()].rhs;
+}
+
+llvm::ArrayRef<NodeId> Ast::get_list(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::List ||
+         this->get_kind(node) == NodeKind::Block);
+  const Data &data = this->data[node.get_raw()];
+  return llvm::ArrayRef<NodeId>(this->extra.data() + data.lhs, data.rhs);
+}
+
+Symbol Ast::get_let_name(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Let);
+  return this->get_name(this->data[node.get_raw()].lhs);
+}
+
+NodeId Ast::get_let_init(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Let);
+  return NodeId(this->data[node.get_raw()].rhs);
+}
+
+Symbol Ast::get_path_module(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Path);
+  return this->get_name(this->data[node.get_raw()].lhs);
+}
+
+Symbol Ast::get_path_name(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Path);
+  return this->get_name(this->data[node.get_raw()].rhs);
+}
+
+Symbol Ast::get_alias_name(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Alias);
+  return this->get_name(this->data[node.get_raw()].lhs);
+}
+
+NodeId Ast::get_alias_target(NodeId node) const {
+  assert(this->get_kind(node) == NodeKind::Alias);
+  return NodeId(this->data[node.get_raw()].rhs);
+}
@@ -1,66 +1,277 @@
 #ifndef MR_MRC_AST_H
 #define MR_MRC_AST_H
 
+#include "Interner.h"
 #include "Lexer.h"
 
-#include <memory>
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
 
-#include <llvm/IR/Value.h>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
-enum class Operation {
+enum class Operation : uint8_t {
   Add,
   Sub,
-};
+  Mul,
+  Div,
+  Rem,
+  BitAnd,
+  BitOr,
+  BitXor,
+  Shl,
+  Shr,
+  LogicalAnd,
+  LogicalOr,
+  Eq,
+  Ne,
+  Lt,
+  Le,
+  Gt,
+  Ge,
 
-// a path like @{a.b.c}::InternalExport
-class Path {
+  Assign,
+  AddAssign,
+  SubAssign,
+  MulAssign,
+  DivAssign,
+  RemAssign,
+  BitAndAssign,
+  BitOrAssign,
+  ShlAssign,
+  ShrAssign,
 
+  // unary
+  Neg,
+  Not,
+  BitNot,
 };
 
-// a path like @{a.b.c}:: 
-class InternalPath {
+bool is_assignment(Operation op);
+// The operation a compound assignment applies before storing.
+Operation get_compound_operation(Operation op);
 
-};
+// Index of a node in an Ast.
+class NodeId {
+public:
+  static constexpr uint32_t Invalid = UINT32_MAX;
 
-class ExternalPath {
+  NodeId() = default;
+  explicit NodeId(uint32_t id) : id(id) {}
 
-};
+  bool is_valid() const { return this->id != Invalid; }
+  uint32_t get_raw() const { return this->id; }
 
-class Module {
+  bool operator==(const NodeId &other) const { return this->id == other.id; }
+  bool operator!=(const NodeId &other) const { return this->id != other.id; }
 
+private:
+  uint32_t id = Invalid;
 };
 
-class Alias {
-
+// Something an identifier can name, found by the Resolver: a `let` at
+// module level or in a block, or the export an alias of a path stands for.
+// Aliases of a name declare nothing of their own.
+struct Declaration {
+  enum Kind : uint8_t { Global, Local, Import };
+  Kind kind;
+  // The Let node, or the Path node of an Import.
+  NodeId node;
 };
 
-class Declaration {
-
+enum class NodeKind : uint8_t {
+  // lhs, rhs: low and high words of the value
+  IntegerLiteral,
+  // lhs: index in the wide integer table, which holds the value in its
+  // exact type
+  WideIntegerLiteral,
+  // lhs, rhs: low and high words of the IEEE double
+  FloatLiteral,
+  // lhs: Lexer string index
+  StringLiteral,
+  // lhs: 0 or 1
+  BoolLiteral,
+  // lhs: Symbol, rhs: index of its Declaration once resolved
+  Identifier,
+  // lhs: operand
+  Unary,
+  // lhs, rhs: operands
+  Binary,
+  // lhs: start in the extra array, rhs: number of NodeIds there
+  List,
+  // lhs: Symbol of the name, rhs: initializer
+  Let,
+  // A path like @{a.b.c}::Name naming an export of another module.
+  // lhs: Symbol of the dotted module name, rhs: Symbol of the export
+  Path,
+  // Statements in a scope of their own.
+  // lhs: start in the extra array, rhs: number of NodeIds there
+  Block,
+  // type Name = target;
+  // lhs: Symbol of the name, rhs: the Identifier or Path it stands for
+  Alias,
 };
 
-class Expression {
+// One of the arrays of an Ast. It owns its elements while a parser appends
+// to them, or views those of a mapped ModuleCache entry. A view may still
+// be rewritten in place; it is only copied out if it has to grow.
+template <typename T> class AstArray {
 public:
-  virtual ~Expression() = default;
-  virtual std::unique_ptr<llvm::Value> codegen() = 0;
+  AstArray() = default;
+  AstArray(AstArray &&other) { *this = std::move(other); }
+  AstArray &operator=(AstArray &&other) {
+    this->owned = std::move(other.owned);
+    this->items = other.items;
+    this->count = other.count;
+    other.clear();
+    return *this;
+  }
+
+  T &operator[](uint32_t index) {
+    assert(index < this->count);
+    return this->items[index];
+  }
+  const T &operator[](uint32_t index) const {
+    assert(index < this->count);
+    return this->items[index];
+  }
+  uint32_t size() const { return this->count; }
+  const T *data() const { return this->items; }
+
+  void append(const T *values, uint32_t size) {
+    if (this->items != this->owned.data()) {
+      this->owned.assign(this->items, this->items + this->count);
+    }
+    this->owned.insert(this->owned.end(), values, values + size);
+    this->sync();
+  }
+  void push_back(const T &value) { this->append(&value, 1); }
+  void reserve(uint32_t size) {
+    if (this->items == this->owned.data()) {
+      this->owned.reserve(size);
+      this->sync();
+    }
+  }
+  void clear() {
+    this->owned.clear();
+    this->sync();
+  }
+  void view(T *items, uint32_t count) {
+    this->owned.clear();
+    this->items = items;
+    this->count = count;
+  }
+
+private:
+  std::vector<T> owned;
+  T *items = nullptr;
+  uint32_t count = 0;
+
+  void sync() {
+    this->items = this->owned.data();
+    this->count = static_cast<uint32_t>(this->owned.size());
+  }
 };
 
-class LiteralExpression : public Expression {
+// A syntax tree stored as parallel arrays indexed by NodeId. Every node has
+// a kind, an operation, the source offset it starts at and two 32-bit data
+// words whose meaning depends on the kind; variable-length children live in
+// the shared extra array. Children are always added before their parents.
+//
+// A tree loaded from the ModuleCache views the entry's arrays, and its
+// nodes hold indices into a table of the entry's names instead of Symbols.
+class Ast {
 public:
-  LiteralExpression(std::unique_ptr<Token> token) : token(std::move(token)) {}
-  std::unique_ptr<llvm::Value> codegen() override;
+  // Numeric values are read from the lexer that produced `token`.
+  NodeId add_literal(const Token &token, const Lexer &lexer);
+  NodeId add_integer(uint32_t offset, uint64_t value);
+  // `value` is two's complement in its type's width.
+  NodeId add_wide_integer(uint32_t offset, const llvm::APInt &value);
+  NodeId add_float(uint32_t offset, double value);
+  NodeId add_string(uint32_t offset, uint32_t string_index);
+  NodeId add_bool(uint32_t offset, bool value);
+  NodeId add_identifier(uint32_t offset, Symbol symbol);
+  NodeId add_unary(uint32_t offset, Operation op, NodeId operand);
+  NodeId add_binary(uint32_t offset, Operation op, NodeId lhs, NodeId rhs);
+  NodeId add_list(uint32_t offset, llvm::ArrayRef<NodeId> items);
+  NodeId add_let(uint32_t offset, Symbol name, NodeId init);
+  NodeId add_path(uint32_t offset, Symbol module, Symbol name);
+  NodeId add_block(uint32_t offset, llvm::ArrayRef<NodeId> statements);
+  NodeId add_alias(uint32_t offset, Symbol name, NodeId target);
+
+  // Rewrite `node` in place, keeping its offset. Its old children become
+  // unreachable; replace() makes it a copy of `with`, sharing its children.
+  void set_integer(NodeId node, uint64_t value);
+  void set_wide_integer(NodeId node, const llvm::APInt &value);
+  void set_float(NodeId node, double value);
+  void set_bool(NodeId node, bool value);
+  void replace(NodeId node, NodeId with);
+  void set_declaration(NodeId identifier, uint32_t declaration);
+
+  void reserve(uint32_t nodes);
+  void clear();
+  uint32_t size() const { return this->kinds.size(); }
+
+  NodeKind get_kind(NodeId node) const { return this->kinds[node.get_raw()]; }
+  Operation get_op(NodeId node) const { return this->ops[node.get_raw()]; }
+  uint32_t get_offset(NodeId node) const {
+    return this->offsets[node.get_raw()];
+  }
+
+  NodeId get_lhs(NodeId node) const;
+  NodeId get_rhs(NodeId node) const;
+  NodeId get_operand(NodeId node) const;
+  uint64_t get_integer(NodeId node) const;
+  llvm::APInt get_wide_integer(NodeId node) const;
+  double get_float(NodeId node) const;
+  uint32_t get_string_index(NodeId node) const;
+  bool get_bool(NodeId node) const;
+  Symbol get_symbol(NodeId node) const;
+  uint32_t get_declaration(NodeId node) const;
+  // The items of a List or the statements of a Block.
+  llvm::ArrayRef<NodeId> get_list(NodeId node) const;
+  Symbol get_let_name(NodeId node) const;
+  NodeId get_let_init(NodeId node) const;
+  Symbol get_path_module(NodeId node) const;
+  Symbol get_path_name(NodeId node) const;
+  Symbol get_alias_name(NodeId node) const;
+  NodeId get_alias_target(NodeId node) const;
 
 private:
-  std::unique_ptr<Token> token;
-};
+  struct Data {
+    uint32_t lhs;
+    uint32_t rhs;
+  };
 
-class BinaryExpr : public Expression {
-  Operation op;
-  std::unique_ptr<Expression> left, right;
+  // A wide integer literal: `bit_width` bits in the words starting at
+  // `word`.
+  struct WideInteger {
+    uint32_t bit_width;
+    uint32_t word;
+  };
 
-public:
-  BinaryExpr(Operation op, std::unique_ptr<Expression> left,
-                std::unique_ptr<Expression> right)
-      : op(op), left(std::move(left)), right(std::move(right)) {}
+  AstArray<NodeKind> kinds;
+  AstArray<Operation> ops;
+  AstArray<uint32_t> offsets;
+  AstArray<Data> data;
+  AstArray<NodeId> extra;
+  AstArray<WideInteger> wide_integers;
+  AstArray<uint64_t> words;
+  // The Symbols of a loaded tree's names; empty if nodes hold Symbols.
+  std::vector<Symbol> names;
+
+  NodeId add(NodeKind kind, Operation op, uint32_t offset, Data data);
+  void set(NodeId node, NodeKind kind, Operation op, Data data);
+  static Data split(uint64_t value);
+  uint64_t join(NodeId node) const;
+  uint32_t add_wide(const llvm::APInt &value);
+  Symbol get_name(uint32_t name) const {
+    return this->names.empty() ? Symbol(name) : this->names[name];
+  }
+
+  friend class ModuleCache;
 };
 
 #endif
@@ -0,0 +1,507 @@
+#include "AstFolder.h"
+
+#include <cassert>
+
+AstFolder::AstFolder(Ast &ast, const Interner &interner,
+                     const InterfaceMap &imports,
+                     llvm::ArrayRef<Declaration> declarations)
+    : ast(ast), interner(interner), imports(imports),
+      declarations(declarations) {}
+
+FoldErrorCode AstFolder::get_error() const { return this->errorCode; }
+
+uint32_t AstFolder::get_error_offset() const { return this->errorOffset; }
+
+bool AstFolder::error(FoldErrorCode code, NodeId node) {
+  this->errorCode = code;
+  this->errorOffset = this->ast.get_offset(node);
+  return false;
+}
+
+// Children precede their parents and statements precede later statements,
+// so a single pass in node order sees every operand folded and every
+// declaration typed before its uses. A `let` and a path take the type of
+// their value, and an identifier that of its declaration's node.
+bool AstFolder::fold() {
+  const uint32_t size = this->ast.size();
+  this->types.assign(size, ValueType());
+  this->targets.clear();
+  this->targets.resize(size);
+  this->errorCode = FoldErrorCode::NoError;
+  this->errorOffset = 0;
+
+  for (uint32_t i = 0; i < size; ++i) {
+    const NodeId node(i);
+    if (this->ast.get_kind(node) == NodeKind::Binary &&
+        is_assignment(this->ast.get_op(node))) {
+      this->targets.set(this->ast.get_lhs(node).get_raw());
+    }
+  }
+
+  for (uint32_t i = 0; i < size; ++i) {
+    const NodeId node(i);
+    ValueType &type = this->types[i];
+    switch (this->ast.get_kind(node)) {
+    case NodeKind::IntegerLiteral:
+      type = {ValueType::Integer,
+              this->ast.get_integer(node) <= INT64_MAX ? 64u : 65u};
+      break;
+    case NodeKind::WideIntegerLiteral:
+      type = {ValueType::Integer,
+              this->ast.get_wide_integer(node).getBitWidth()};
+      break;
+    case NodeKind::FloatLiteral:
+      type = {ValueType::Float, 64};
+      break;
+    case NodeKind::StringLiteral:
+      type = {ValueType::String, 0};
+      break;
+    case NodeKind::BoolLiteral:
+      type = {ValueType::Integer, 1};
+      break;
+    case NodeKind::Identifier: {
+      const Declaration &declaration =
+          this->declarations[this->ast.get_declaration(node)];
+      type = this->types[declaration.node.get_raw()];
+      break;
+    }
+    case NodeKind::Path:
+      type = this->get_import_type(node);
+      break;
+    case NodeKind::Unary:
+      if (!this->fold_unary(node)) {
+        return false;
+      }
+      break;
+    case NodeKind::Binary:
+      if (!this->fold_binary(node)) {
+        return false;
+      }
+      break;
+    case NodeKind::List:
+    case NodeKind::Block:
+    case NodeKind::Alias:
+      break;
+    case NodeKind::Let:
+      type = this->types[this->ast.get_let_init(node).get_raw()];
+      break;
+    }
+  }
+  return true;
+}
+
+// Unknown if the module or the export is missing; CodeGen reports it.
+ValueType AstFolder::get_import_type(NodeId path) const {
+  auto module = this->imports.find(this->ast.get_path_module(path).get_raw());
+  if (module == this->imports.end()) {
+    return ValueType();
+  }
+  const ModuleInterface::Export *symbol = module->second->find(
+      this->interner.get_spelling(this->ast.get_path_name(path)));
+  return symbol != nullptr ? symbol->type : ValueType();
+}
+
+bool AstFolder::fold_unary(NodeId node) {
+  const Operation op = this->ast.get_op(node);
+  const NodeId operand = this->ast.get_operand(node);
+  const ValueType type = this->types[operand.get_raw()];
+
+  ValueType result;
+  switch (op) {
+  case Operation::Neg:
+    if (type.kind == ValueType::Float ||
+        (type.kind == ValueType::Integer && !type.is_bool())) {
+      result = type;
+    }
+    break;
+  case Operation::Not:
+    if (type.kind == ValueType::Integer || type.kind == ValueType::Float) {
+      result = {ValueType::Integer, 1};
+    }
+    break;
+  case Operation::BitNot:
+    if (type.kind == ValueType::Integer) {
+      result = type;
+    }
+    break;
+  default:
+    assert(false && "not a unary operation");
+  }
+  this->types[node.get_raw()] = result;
+
+  Constant value;
+  if (result.kind == ValueType::Unknown ||
+      !this->get_constant(operand, value)) {
+    return true;
+  }
+  switch (op) {
+  case Operation::Neg:
+    if (type.kind == ValueType::Float) {
+      value.real.changeSign();
+    } else {
+      bool overflow;
+      value.integer =
+          llvm::APInt(type.width, 0).ssub_ov(value.integer, overflow);
+      if (overflow) {
+        return this->error(FoldErrorCode::IntegerOverflow, node);
+      }
+    }
+    break;
+  case Operation::Not:
+    value.integer = llvm::APInt(1, !to_bool(value));
+    value.type = result;
+    break;
+  default:
+    value.integer.flipAllBits();
+    break;
+  }
+  this->set_constant(node, value);
+  return true;
+}
+
+bool AstFolder::fold_binary(NodeId node) {
+  const Operation op = this->ast.get_op(node);
+  const NodeId lhs = this->ast.get_lhs(node);
+  const NodeId rhs = this->ast.get_rhs(node);
+  const ValueType a = this->types[lhs.get_raw()];
+  const ValueType b = this->types[rhs.get_raw()];
+
+  // Assignments are never folded; their value has the target's type.
+  if (is_assignment(op)) {
+    const ValueType value = op == Operation::Assign
+                           ? b
+                           : get_result_type(get_compound_operation(op), a, b);
+    if (this->ast.get_kind(lhs) == NodeKind::Identifier &&
+        a.kind != ValueType::Unknown && widens_to(value, a)) {
+      this->types[node.get_raw()] = a;
+    }
+    return true;
+  }
+
+  const ValueType result = get_result_type(op, a, b);
+  this->types[node.get_raw()] = result;
+  if (result.kind == ValueType::Unknown) {
+    return true;
+  }
+
+  Constant x;
+  Constant y;
+  const bool lhs_constant = this->get_constant(lhs, x);
+  const bool rhs_constant = this->get_constant(rhs, y);
+  if (!lhs_constant || !rhs_constant) {
+    if (lhs_constant || rhs_constant) {
+      this->simplify(node, lhs, rhs, result);
+    }
+    return true;
+  }
+
+  Constant value;
+  value.type = result;
+  if (op == Operation::LogicalAnd || op == Operation::LogicalOr) {
+    const bool truth = op == Operation::LogicalAnd
+                           ? to_bool(x) && to_bool(y)
+                           : to_bool(x) || to_bool(y);
+    value.integer = llvm::APInt(1, truth);
+    this->set_constant(node, value);
+    return true;
+  }
+
+  const ValueType type = unify(a, b);
+  x = convert(x, type);
+  y = convert(y, type);
+
+  if (type.kind == ValueType::Float) {
+    const llvm::APFloat::cmpResult order = x.real.compare(y.real);
+    const llvm::RoundingMode rounding = llvm::APFloat::rmNearestTiesToEven;
+    value.real = x.real;
+    switch (op) {
+    case Operation::Add:
+      value.real.add(y.real, rounding);
+      break;
+    case Operation::Sub:
+      value.real.subtract(y.real, rounding);
+      break;
+    case Operation::Mul:
+      value.real.multiply(y.real, rounding);
+      break;
+    case Operation::Div:
+      value.real.divide(y.real, rounding);
+      break;
+    case Operation::Rem:
+      value.real.mod(y.real);
+      break;
+    // Equality and the orderings are false for NaN, != is true.
+    case Operation::Eq:
+      value.integer = llvm::APInt(1, order == llvm::APFloat::cmpEqual);
+      break;
+    case Operation::Ne:
+      value.integer = llvm::APInt(1, order != llvm::APFloat::cmpEqual);
+      break;
+    case Operation::Lt:
+      value.integer = llvm::APInt(1, order == llvm::APFloat::cmpLessThan);
+      break;
+    case Operation::Le:
+      value.integer = llvm::APInt(1, order == llvm::APFloat::cmpLessThan ||
+                                         order == llvm::APFloat::cmpEqual);
+      break;
+    case Operation::Gt:
+      value.integer = llvm::APInt(1, order == llvm::APFloat::cmpGreaterThan);
+      break;
+    case Operation::Ge:
+      value.integer = llvm::APInt(1, order == llvm::APFloat::cmpGreaterThan ||
+                                         order == llvm::APFloat::cmpEqual);
+      break;
+    default:
+      assert(false && "invalid float operation");
+    }
+    this->set_constant(node, value);
+    return true;
+  }
+
+  const llvm::APInt &l = x.integer;
+  const llvm::APInt &r = y.integer;
+  // Booleans order false before true.
+  const bool is_unsigned = type.is_bool();
+  bool overflow = false;
+  switch (op) {
+  case Operation::Add:
+    value.integer = l.sadd_ov(r, overflow);
+    break;
+  case Operation::Sub:
+    value.integer = l.ssub_ov(r, overflow);
+    break;
+  case Operation::Mul:
+    value.integer = l.smul_ov(r, overflow);
+    break;
+  case Operation::Div:
+    if (r.isZero()) {
+      return this->error(FoldErrorCode::DivisionByZero, node);
+    }
+    value.integer = l.sdiv_ov(r, overflow);
+    break;
+  case Operation::Rem:
+    if (r.isZero()) {
+      return this->error(FoldErrorCode::DivisionByZero, node);
+    }
+    overflow = l.isMinSignedValue() && r.isAllOnes();
+    value.integer = l.srem(r);
+    break;
+  case Operation::BitAnd:
+    value.integer = l & r;
+    break;
+  case Operation::BitOr:
+    value.integer = l | r;
+    break;
+  case Operation::BitXor:
+    value.integer = l ^ r;
+    break;
+  case Operation::Shl:
+  case Operation::Shr:
+    if (r.isNegative() || r.uge(type.width)) {
+      return this->error(FoldErrorCode::ShiftOutOfRange, node);
+    }
+    value.integer = op == Operation::Shl ? l.shl(r) : l.ashr(r);
+    break;
+  case Operation::Eq:
+    value.integer = llvm::APInt(1, l == r);
+    break;
+  case Operation::Ne:
+    value.integer = llvm::APInt(1, l != r);
+    break;
+  case Operation::Lt:
+    value.integer = llvm::APInt(1, is_unsigned ? l.ult(r) : l.slt(r));
+    break;
+  case Operation::Le:
+    value.integer = llvm::APInt(1, is_unsigned ? l.ule(r) : l.sle(r));
+    break;
+  case Operation::Gt:
+    value.integer = llvm::APInt(1, is_unsigned ? l.ugt(r) : l.sgt(r));
+    break;
+  case Operation::Ge:
+    value.integer = llvm::APInt(1, is_unsigned ? l.uge(r) : l.sge(r));
+    break;
+  default:
+    assert(false && "invalid integer operation");
+  }
+  if (overflow) {
+    return this->error(FoldErrorCode::IntegerOverflow, node);
+  }
+  this->set_constant(node, value);
+  return true;
+}
+
+// Replaces `node` by its non-constant operand where the constant one leaves
+// it unchanged. Floats only take identities that hold for -0.0 too.
+void AstFolder::simplify(NodeId node, NodeId lhs, NodeId rhs, ValueType type) {
+  if (this->targets.test(node.get_raw())) {
+    return;
+  }
+  Constant constant;
+  const bool on_right = this->get_constant(rhs, constant);
+  if (!on_right) {
+    this->get_constant(lhs, constant);
+  }
+  const NodeId other = on_right ? lhs : rhs;
+  if (this->types[other.get_raw()] != type) {
+    return;
+  }
+  constant = convert(constant, type);
+
+  bool zero;
+  bool one;
+  bool ones = false;
+  if (type.kind == ValueType::Float) {
+    zero = constant.real.isPosZero();
+    one = constant.real.compare(llvm::APFloat(1.0)) == llvm::APFloat::cmpEqual;
+  } else {
+    zero = constant.integer.isZero();
+    one = constant.integer.isOne();
+    ones = constant.integer.isAllOnes();
+  }
+  const bool is_integer = type.kind == ValueType::Integer;
+
+  bool identity = false;
+  switch (this->ast.get_op(node)) {
+  case Operation::Add:
+  case Operation::BitOr:
+  case Operation::BitXor:
+    identity = is_integer && zero;
+    break;
+  case Operation::Sub:
+  case Operation::Shl:
+  case Operation::Shr:
+    identity = on_right && zero;
+    break;
+  case Operation::Mul:
+    identity = one;
+    break;
+  case Operation::Div:
+    identity = on_right && one;
+    break;
+  case Operation::BitAnd:
+    identity = ones;
+    break;
+  default:
+    break;
+  }
+  if (identity) {
+    this->ast.replace(node, other);
+  }
+}
+
+bool AstFolder::get_constant(NodeId node, Constant &constant) const {
+  constant.type = this->types[node.get_raw()];
+  switch (this->ast.get_kind(node)) {
+  case NodeKind::IntegerLiteral:
+    constant.integer =
+        llvm::APInt(constant.type.width, this->ast.get_integer(node));
+    return true;
+  case NodeKind::WideIntegerLiteral:
+    constant.integer = this->ast.get_wide_integer(node);
+    return true;
+  case NodeKind::FloatLiteral:
+    constant.real = llvm::APFloat(this->ast.get_float(node));
+    return true;
+  case NodeKind::BoolLiteral:
+    constant.integer = llvm::APInt(1, this->ast.get_bool(node));
+    return true;
+  default:
+    return false;
+  }
+}
+
+void AstFolder::set_constant(NodeId node, const Constant &constant) {
+  const llvm::APInt &integer = constant.integer;
+  if (constant.type.kind == ValueType::Float) {
+    this->ast.set_float(node, constant.real.convertToDouble());
+  } else if (constant.type.is_bool()) {
+    this->ast.set_bool(node, integer.getBoolValue());
+  } else if (constant.type.width == 64 && !integer.isNegative()) {
+    this->ast.set_integer(node, integer.getZExtValue());
+  } else {
+    this->ast.set_wide_integer(node, integer);
+  }
+}
+
+ValueType AstFolder::unify(ValueType lhs, ValueType rhs) {
+  if (lhs.kind == ValueType::Unknown || rhs.kind == ValueType::Unknown) {
+    return ValueType();
+  }
+  if (lhs == rhs) {
+    return lhs;
+  }
+  if (lhs.kind == ValueType::String || rhs.kind == ValueType::String) {
+    return ValueType();
+  }
+  if (lhs.kind == ValueType::Float || rhs.kind == ValueType::Float) {
+    return {ValueType::Float, 64};
+  }
+  return lhs.width > rhs.width ? lhs : rhs;
+}
+
+// The type CodeGen gives `lhs op rhs`, or Unknown where it reports invalid
+// operands.
+ValueType AstFolder::get_result_type(Operation op, ValueType lhs,
+                                     ValueType rhs) {
+  if (op == Operation::LogicalAnd || op == Operation::LogicalOr) {
+    const bool valid =
+        (lhs.kind == ValueType::Integer || lhs.kind == ValueType::Float) &&
+        (rhs.kind == ValueType::Integer || rhs.kind == ValueType::Float);
+    return valid ? ValueType{ValueType::Integer, 1} : ValueType();
+  }
+  const ValueType type = unify(lhs, rhs);
+  if (type.kind != ValueType::Integer && type.kind != ValueType::Float) {
+    return ValueType();
+  }
+  switch (op) {
+  case Operation::Add:
+  case Operation::Sub:
+  case Operation::Mul:
+  case Operation::Div:
+  case Operation::Rem:
+    return type.is_bool() ? ValueType() : type;
+  case Operation::BitAnd:
+  case Operation::BitOr:
+  case Operation::BitXor:
+    return type.kind == ValueType::Float ? ValueType() : type;
+  case Operation::Shl:
+  case Operation::Shr:
+    return type.kind == ValueType::Float || type.is_bool() ? ValueType() : type;
+  default:
+    return {ValueType::Integer, 1};
+  }
+}
+
+bool AstFolder::widens_to(ValueType from, ValueType to) {
+  return from == to ||
+         (from.kind == ValueType::Integer &&
+          (to.kind == ValueType::Float ||
+           (to.kind == ValueType::Integer && to.width > from.width)));
+}
+
+// Mirrors CodeGen::widen: booleans zero-extend, integers sign-extend and
+// both convert to double with round-to-nearest-even.
+AstFolder::Constant AstFolder::convert(const Constant &constant,
+                                       ValueType type) {
+  if (constant.type == type) {
+    return constant;
+  }
+  Constant result;
+  result.type = type;
+  if (type.kind == ValueType::Float) {
+    result.real = llvm::APFloat(llvm::APFloat::IEEEdouble());
+    result.real.convertFromAPInt(constant.integer, !constant.type.is_bool(),
+                                 llvm::APFloat::rmNearestTiesToEven);
+  } else if (constant.type.is_bool()) {
+    result.integer = constant.integer.zext(type.width);
+  } else {
+    result.integer = constant.integer.sext(type.width);
+  }
+  return result;
+}
+
+// NaN is true, like `fcmp une x, 0.0`.
+bool AstFolder::to_bool(const Constant &constant) {
+  return constant.type.kind == ValueType::Float ? !constant.real.isZero()
+                                           : !constant.integer.isZero();
+}
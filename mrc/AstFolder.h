@@ -0,0 +1,74 @@
+#ifndef MR_MRC_ASTFOLDER_H
+#define MR_MRC_ASTFOLDER_H
+
+#include "AST.h"
+#include "Interner.h"
+#include "ModuleInterface.h"
+#include "ValueType.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+
+#include <cstdint>
+#include <vector>
+
+enum class FoldErrorCode {
+  NoError = 0,
+  IntegerOverflow,
+  DivisionByZero,
+  ShiftOutOfRange,
+};
+
+// Evaluates constant expressions in an Ast before code generation, with the
+// same types and exact semantics CodeGen gives them at run time, and
+// applies identities such as `x + 0` and `x * 1` where they keep the type.
+// Folded nodes are rewritten in place. Integer arithmetic that would
+// overflow, divide by zero or shift by more than the width is an error.
+class AstFolder {
+public:
+  // Paths take the types of the exports `imports` lists for them, and
+  // identifiers those of the `declarations` the Resolver bound them to.
+  AstFolder(Ast &ast, const Interner &interner, const InterfaceMap &imports,
+            llvm::ArrayRef<Declaration> declarations);
+
+  // Returns false at the first error.
+  bool fold();
+
+  FoldErrorCode get_error() const;
+  // Byte offset of the node that caused the last error.
+  uint32_t get_error_offset() const;
+
+private:
+  struct Constant {
+    ValueType type;
+    llvm::APInt integer;
+    llvm::APFloat real{0.0};
+  };
+
+  Ast &ast;
+  const Interner &interner;
+  const InterfaceMap &imports;
+  llvm::ArrayRef<Declaration> declarations;
+  std::vector<ValueType> types;
+  // Left operands of assignments, which must stay identifiers.
+  llvm::BitVector targets;
+  FoldErrorCode errorCode = FoldErrorCode::NoError;
+  uint32_t errorOffset = 0;
+
+  ValueType get_import_type(NodeId path) const;
+  bool fold_unary(NodeId node);
+  bool fold_binary(NodeId node);
+  void simplify(NodeId node, NodeId lhs, NodeId rhs, ValueType type);
+  bool get_constant(NodeId node, Constant &constant) const;
+  void set_constant(NodeId node, const Constant &constant);
+  static ValueType get_result_type(Operation op, ValueType lhs, ValueType rhs);
+  static ValueType unify(ValueType lhs, ValueType rhs);
+  static bool widens_to(ValueType from, ValueType to);
+  static Constant convert(const Constant &constant, ValueType type);
+  static bool to_bool(const Constant &constant);
+  bool error(FoldErrorCode code, NodeId node);
+};
+
+#endif
@@ -0,0 +1,461 @@
+#include "CharScan.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MR_CHARSCAN_X86 1
+#include <immintrin.h>
+#define MR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+using ScanFn = const char *(*)(const char *, const char *);
+using QuoteScanFn = const char *(*)(const char *, const char *, char);
+
+inline bool is_blank(uint8_t c) {
+  return (c >= 0x09 && c <= 0x0D) || c == 0x1F || c == 0x20;
+}
+
+inline bool is_line_candidate(uint8_t c) {
+  return c == '\n' || c == '\r' || c == 0xE2;
+}
+
+inline bool is_string_stop(char c, char quote) {
+  return c == quote || c == '\\' || c == '\n' || c == '\r';
+}
+
+inline bool is_ident(uint8_t c) {
+  return static_cast<uint8_t>((c | 0x20) - 'a') <= 'z' - 'a' ||
+         static_cast<uint8_t>(c - '0') <= 9 || c == '_' || c == '$';
+}
+
+const char *skip_blank_scalar(const char *cur, const char *end) {
+  while (cur < end && is_blank(*cur)) {
+    ++cur;
+  }
+  return cur;
+}
+
+// Stops at LF, CR and every 0xE2 lead byte; find_line_end() checks whether
+// an 0xE2 actually starts LS or PS.
+const char *find_line_candidate_scalar(const char *cur, const char *end) {
+  while (cur < end && !is_line_candidate(*cur)) {
+    ++cur;
+  }
+  return cur;
+}
+
+const char *find_block_comment_end_scalar(const char *cur, const char *end) {
+  for (; end - cur >= 2; ++cur) {
+    if (cur[0] == '*' && cur[1] == '/') {
+      return cur;
+    }
+  }
+  return end;
+}
+
+const char *find_string_end_scalar(const char *cur, const char *end,
+                                   char quote) {
+  while (cur < end && !is_string_stop(*cur, quote)) {
+    ++cur;
+  }
+  return cur;
+}
+
+const char *find_ident_end_scalar(const char *cur, const char *end) {
+  while (cur < end && is_ident(*cur)) {
+    ++cur;
+  }
+  return cur;
+}
+
+const char *find_non_ascii_scalar(const char *cur, const char *end) {
+  while (cur < end && static_cast<uint8_t>(*cur) < 0x80) {
+    ++cur;
+  }
+  return cur;
+}
+
+// Checks one multi-byte sequence against the well-formed byte sequences of
+// the Unicode standard (Table 3-7), which also rules out overlong forms,
+// surrogates and code points above U+10FFFF. Returns the byte after it, or
+// nullptr if it is ill-formed.
+const char *validate_sequence(const char *cur, const char *end) {
+  const uint8_t lead = *cur;
+  int length;
+  uint8_t lo = 0x80, hi = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    lo = lead == 0xE0 ? 0xA0 : 0x80;
+    hi = lead == 0xED ? 0x9F : 0xBF;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    lo = lead == 0xF0 ? 0x90 : 0x80;
+    hi = lead == 0xF4 ? 0x8F : 0xBF;
+  } else {
+    return nullptr;
+  }
+
+  if (end - cur < length) {
+    return nullptr;
+  }
+  const uint8_t second = cur[1];
+  if (second < lo || second > hi) {
+    return nullptr;
+  }
+  for (int i = 2; i < length; ++i) {
+    if ((static_cast<uint8_t>(cur[i]) & 0xC0) != 0x80) {
+      return nullptr;
+    }
+  }
+  return cur + length;
+}
+
+#ifdef MR_CHARSCAN_X86
+
+// SSE2 is part of the x86-64 baseline, so these need no target attribute.
+
+inline __m128i le_u8_sse2(__m128i v, char bound) {
+  const __m128i k = _mm_set1_epi8(bound);
+  return _mm_cmpeq_epi8(_mm_max_epu8(v, k), k);
+}
+
+inline __m128i blank_sse2(__m128i v) {
+  return _mm_or_si128(
+      le_u8_sse2(_mm_sub_epi8(v, _mm_set1_epi8(0x09)), 0x0D - 0x09),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x1F)),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8(0x20))));
+}
+
+inline __m128i ident_sse2(__m128i v) {
+  const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  return _mm_or_si128(
+      _mm_or_si128(le_u8_sse2(_mm_sub_epi8(lower, _mm_set1_epi8('a')), 25),
+                   le_u8_sse2(_mm_sub_epi8(v, _mm_set1_epi8('0')), 9)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                   _mm_cmpeq_epi8(v, _mm_set1_epi8('$'))));
+}
+
+const char *skip_blank_sse2(const char *cur, const char *end) {
+  for (; end - cur >= 16; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const unsigned stop = ~_mm_movemask_epi8(blank_sse2(v)) & 0xFFFF;
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return skip_blank_scalar(cur, end);
+}
+
+const char *find_line_candidate_sse2(const char *cur, const char *end) {
+  for (; end - cur >= 16; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const __m128i hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+        _mm_cmpeq_epi8(v, _mm_set1_epi8('\xE2')));
+    const unsigned stop = _mm_movemask_epi8(hit);
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_line_candidate_scalar(cur, end);
+}
+
+const char *find_block_comment_end_sse2(const char *cur, const char *end) {
+  for (; end - cur >= 17; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const __m128i next =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + 1));
+    const unsigned stop = _mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                      _mm_cmpeq_epi8(next, _mm_set1_epi8('/'))));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_block_comment_end_scalar(cur, end);
+}
+
+const char *find_string_end_sse2(const char *cur, const char *end,
+                                 char quote) {
+  for (; end - cur >= 16; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const __m128i hit = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    const unsigned stop = _mm_movemask_epi8(hit);
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_string_end_scalar(cur, end, quote);
+}
+
+const char *find_non_ascii_sse2(const char *cur, const char *end) {
+  for (; end - cur >= 64; cur += 64) {
+    const __m128i *p = reinterpret_cast<const __m128i *>(cur);
+    const __m128i any = _mm_or_si128(
+        _mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+        _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    if (_mm_movemask_epi8(any) != 0) {
+      break;
+    }
+  }
+  for (; end - cur >= 16; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const unsigned stop = _mm_movemask_epi8(v);
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_non_ascii_scalar(cur, end);
+}
+
+const char *find_ident_end_sse2(const char *cur, const char *end) {
+  for (; end - cur >= 16; cur += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    const unsigned stop = ~_mm_movemask_epi8(ident_sse2(v)) & 0xFFFF;
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_ident_end_scalar(cur, end);
+}
+
+MR_TARGET_AVX2 inline __m256i le_u8_avx2(__m256i v, char bound) {
+  const __m256i k = _mm256_set1_epi8(bound);
+  return _mm256_cmpeq_epi8(_mm256_max_epu8(v, k), k);
+}
+
+MR_TARGET_AVX2 inline __m256i blank_avx2(__m256i v) {
+  return _mm256_or_si256(
+      le_u8_avx2(_mm256_sub_epi8(v, _mm256_set1_epi8(0x09)), 0x0D - 0x09),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x1F)),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x20))));
+}
+
+MR_TARGET_AVX2 inline __m256i ident_avx2(__m256i v) {
+  const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  return _mm256_or_si256(
+      _mm256_or_si256(
+          le_u8_avx2(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), 25),
+          le_u8_avx2(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), 9)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')),
+                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('$'))));
+}
+
+MR_TARGET_AVX2 const char *skip_blank_avx2(const char *cur, const char *end) {
+  for (; end - cur >= 32; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const uint32_t stop = ~static_cast<uint32_t>(
+        _mm256_movemask_epi8(blank_avx2(v)));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return skip_blank_sse2(cur, end);
+}
+
+MR_TARGET_AVX2 const char *find_line_candidate_avx2(const char *cur,
+                                                    const char *end) {
+  for (; end - cur >= 32; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\xE2')));
+    const uint32_t stop = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_line_candidate_sse2(cur, end);
+}
+
+MR_TARGET_AVX2 const char *find_block_comment_end_avx2(const char *cur,
+                                                       const char *end) {
+  for (; end - cur >= 33; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const __m256i next =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur + 1));
+    const uint32_t stop = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                         _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/')))));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_block_comment_end_sse2(cur, end);
+}
+
+MR_TARGET_AVX2 const char *find_string_end_avx2(const char *cur,
+                                                const char *end, char quote) {
+  for (; end - cur >= 32; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const __m256i hit = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+    const uint32_t stop = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_string_end_sse2(cur, end, quote);
+}
+
+MR_TARGET_AVX2 const char *find_non_ascii_avx2(const char *cur,
+                                               const char *end) {
+  for (; end - cur >= 128; cur += 128) {
+    const __m256i *p = reinterpret_cast<const __m256i *>(cur);
+    const __m256i any = _mm256_or_si256(
+        _mm256_or_si256(_mm256_loadu_si256(p), _mm256_loadu_si256(p + 1)),
+        _mm256_or_si256(_mm256_loadu_si256(p + 2), _mm256_loadu_si256(p + 3)));
+    if (_mm256_movemask_epi8(any) != 0) {
+      break;
+    }
+  }
+  for (; end - cur >= 32; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const uint32_t stop = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_non_ascii_sse2(cur, end);
+}
+
+MR_TARGET_AVX2 const char *find_ident_end_avx2(const char *cur,
+                                               const char *end) {
+  for (; end - cur >= 32; cur += 32) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    const uint32_t stop = ~static_cast<uint32_t>(
+        _mm256_movemask_epi8(ident_avx2(v)));
+    if (stop != 0) {
+      return cur + __builtin_ctz(stop);
+    }
+  }
+  return find_ident_end_sse2(cur, end);
+}
+
+#endif
+
+struct Kernels {
+  const char *isa;
+  ScanFn skip_blank;
+  ScanFn find_line_candidate;
+  ScanFn find_block_comment_end;
+  QuoteScanFn find_string_end;
+  ScanFn find_ident_end;
+  ScanFn find_non_ascii;
+};
+
+Kernels select_kernels() {
+#ifdef MR_CHARSCAN_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {"avx2",
+            skip_blank_avx2,
+            find_line_candidate_avx2,
+            find_block_comment_end_avx2,
+            find_string_end_avx2,
+            find_ident_end_avx2,
+            find_non_ascii_avx2};
+  }
+  return {"sse2",
+          skip_blank_sse2,
+          find_line_candidate_sse2,
+          find_block_comment_end_sse2,
+          find_string_end_sse2,
+          find_ident_end_sse2,
+          find_non_ascii_sse2};
+#else
+  return {"scalar",
+          skip_blank_scalar,
+          find_line_candidate_scalar,
+          find_block_comment_end_scalar,
+          find_string_end_scalar,
+          find_ident_end_scalar,
+          find_non_ascii_scalar};
+#endif
+}
+
+const Kernels Active = select_kernels();
+
+} // namespace
+
+// Runs of blanks and identifier characters are usually short, so the first
+// byte is checked before paying for the vector setup.
+
+const char *CharScan::skip_blank(const char *cur, const char *end) {
+  if (cur == end || !is_blank(*cur)) {
+    return cur;
+  }
+  return Active.skip_blank(cur + 1, end);
+}
+
+const char *CharScan::find_line_end(const char *cur, const char *end) {
+  while (true) {
+    cur = Active.find_line_candidate(cur, end);
+    if (cur == end || *cur != '\xE2') {
+      return cur;
+    }
+    if (end - cur >= 3 && cur[1] == '\x80' &&
+        (cur[2] == '\xA8' || cur[2] == '\xA9')) {
+      return cur;
+    }
+    ++cur;
+  }
+}
+
+const char *CharScan::find_block_comment_end(const char *cur,
+                                             const char *end) {
+  return Active.find_block_comment_end(cur, end);
+}
+
+const char *CharScan::find_string_end(const char *cur, const char *end,
+                                      char quote) {
+  return Active.find_string_end(cur, end, quote);
+}
+
+const char *CharScan::find_ident_end(const char *cur, const char *end) {
+  if (cur == end || !is_ident(*cur)) {
+    return cur;
+  }
+  return Active.find_ident_end(cur + 1, end);
+}
+
+// ASCII runs are skipped by the vector kernel; the multi-byte sequences in
+// between are checked one at a time, which keeps the error offset exact.
+const char *CharScan::validate_utf8(const char *cur, const char *end,
+                                    bool &ascii) {
+  while (true) {
+    cur = Active.find_non_ascii(cur, end);
+    if (cur == end) {
+      return end;
+    }
+    ascii = false;
+    do {
+      const char *next = validate_sequence(cur, end);
+      if (next == nullptr) {
+        return cur;
+      }
+      cur = next;
+    } while (cur < end && static_cast<uint8_t>(*cur) >= 0x80);
+  }
+}
+
+const char *CharScan::get_isa() { return Active.isa; }
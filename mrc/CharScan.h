@@ -0,0 +1,36 @@
+#ifndef MR_MRC_CHARSCAN_H
+#define MR_MRC_CHARSCAN_H
+
+// Byte-run scanners for the lexer's hot loops. Each one has SSE2 and AVX2
+// kernels picked once at startup from the running CPU, and a scalar fallback
+// for other targets. All of them return `end` if the run reaches it.
+class CharScan {
+public:
+  // First byte that is not ASCII blank: HT, LF, VT, FF, CR, US or SP.
+  static const char *skip_blank(const char *cur, const char *end);
+
+  // First line terminator: LF, CR, LS (E2 80 A8) or PS (E2 80 A9).
+  static const char *find_line_end(const char *cur, const char *end);
+
+  // The '*' of the first "*/".
+  static const char *find_block_comment_end(const char *cur, const char *end);
+
+  // First `quote`, backslash, LF or CR: where a string literal's run of
+  // plain bytes ends.
+  static const char *find_string_end(const char *cur, const char *end,
+                                     char quote);
+
+  // First byte that is not one of [A-Za-z0-9_$]. Non-ASCII identifier
+  // characters stop the scan and are left to the caller.
+  static const char *find_ident_end(const char *cur, const char *end);
+
+  // Start of the first ill-formed UTF-8 sequence, or `end` if the whole
+  // range is valid. `ascii` is cleared on the first byte above 0x7F.
+  static const char *validate_utf8(const char *cur, const char *end,
+                                   bool &ascii);
+
+  // Name of the selected kernel set: "avx2", "sse2" or "scalar".
+  static const char *get_isa();
+};
+
+#endif
@@ -0,0 +1,601 @@
+#include "CodeGen.h"
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace {
+
+bool is_bool(llvm::Type *type) { return type->isIntegerTy(1); }
+
+ValueType get_value_type(llvm::Type *type) {
+  if (type->isIntegerTy()) {
+    return {ValueType::Integer, type->getIntegerBitWidth()};
+  }
+  return type->isDoubleTy() ? ValueType{ValueType::Float, 64}
+                            : ValueType{ValueType::String, 0};
+}
+
+// Constructors with priorities up to 100 are reserved for the C runtime.
+constexpr uint32_t FirstPriority = 101;
+constexpr uint32_t LastPriority = 65535;
+
+} // namespace
+
+CodeGen::CodeGen(llvm::LLVMContext &context, const Interner &interner,
+                 const Ast &ast, llvm::ArrayRef<llvm::StringRef> strings,
+                 llvm::ArrayRef<Declaration> declarations,
+                 const InterfaceMap &imports)
+    : context(context), interner(interner), ast(ast), strings(strings),
+      declarations(declarations), imports(imports), builder(context) {}
+
+std::unique_ptr<llvm::Module> CodeGen::generate(llvm::StringRef name,
+                                                NodeId root, uint32_t depth) {
+  this->module = std::make_unique<llvm::Module>(name, this->context);
+  this->storage.assign(this->declarations.size(), {nullptr, nullptr});
+  this->nextDeclaration = 0;
+  this->exports.clear();
+  this->errorCode = CodeGenErrorCode::NoError;
+  this->errorOffset = 0;
+
+  std::vector<llvm::Function *> inits;
+  if (root.is_valid()) {
+    const llvm::ArrayRef<NodeId> statements = this->ast.get_list(root);
+    for (uint32_t i = 0; i < statements.size(); ++i) {
+      if (this->ast.get_kind(statements[i]) == NodeKind::Alias) {
+        this->skip_alias(statements[i]);
+        continue;
+      }
+      llvm::Function *init = this->emit_statement(statements[i], i);
+      if (init == nullptr) {
+        return nullptr;
+      }
+      inits.push_back(init);
+    }
+  }
+
+  if (!inits.empty()) {
+    llvm::Function *ctor = llvm::Function::Create(
+        llvm::FunctionType::get(this->builder.getVoidTy(), false),
+        llvm::GlobalValue::InternalLinkage, "mrc.init", *this->module);
+    this->builder.SetInsertPoint(
+        llvm::BasicBlock::Create(this->context, "entry", ctor));
+    for (llvm::Function *init : inits) {
+      this->builder.CreateCall(init);
+    }
+    this->builder.CreateRetVoid();
+    // Lower priorities run first, so imported modules are initialized
+    // before their importers.
+    llvm::appendToGlobalCtors(
+        *this->module, ctor,
+        std::min(FirstPriority + depth, LastPriority));
+  }
+  assert(this->nextDeclaration == this->declarations.size());
+
+  assert(!llvm::verifyModule(*this->module, &llvm::errs()));
+  return std::move(this->module);
+}
+
+llvm::ArrayRef<ModuleInterface::Export> CodeGen::get_exports() const {
+  return this->exports;
+}
+
+CodeGenErrorCode CodeGen::get_error() const { return this->errorCode; }
+
+uint32_t CodeGen::get_error_offset() const { return this->errorOffset; }
+
+void CodeGen::error(CodeGenErrorCode code, NodeId node) {
+  this->errorCode = code;
+  this->errorOffset = this->ast.get_offset(node);
+}
+
+llvm::Function *CodeGen::emit_statement(NodeId statement, uint32_t index) {
+  const NodeKind kind = this->ast.get_kind(statement);
+  const bool is_let = kind == NodeKind::Let;
+  std::string name = "mrc.stmt." + std::to_string(index);
+  if (is_let) {
+    name = this->interner.get_spelling(this->ast.get_let_name(statement));
+    name += ".init";
+  }
+
+  // Named once the global exists, so that a clash renames the internal
+  // function rather than the exported global.
+  llvm::Function *function = llvm::Function::Create(
+      llvm::FunctionType::get(this->builder.getVoidTy(), false),
+      llvm::GlobalValue::InternalLinkage, "", *this->module);
+  this->builder.SetInsertPoint(
+      llvm::BasicBlock::Create(this->context, "entry", function));
+
+  if (kind == NodeKind::Block) {
+    if (!this->emit_block(statement)) {
+      return nullptr;
+    }
+    this->builder.CreateRetVoid();
+    function->setName(name);
+    return function;
+  }
+
+  llvm::Value *value = this->emit_expression(
+      is_let ? this->ast.get_let_init(statement) : statement);
+  if (value == nullptr) {
+    return nullptr;
+  }
+  if (is_let) {
+    const Symbol symbol = this->ast.get_let_name(statement);
+    const llvm::StringRef spelling = this->interner.get_spelling(symbol);
+    auto *global = new llvm::GlobalVariable(
+        *this->module, value->getType(), /*isConstant=*/false,
+        llvm::GlobalValue::ExternalLinkage,
+        llvm::Constant::getNullValue(value->getType()),
+        llvm::Twine(this->module->getModuleIdentifier()) + "." + spelling);
+    this->builder.CreateStore(value, global);
+    this->storage[this->take_declaration(statement)] = {global,
+                                                        value->getType()};
+    this->exports.push_back(
+        {spelling.str(), get_value_type(value->getType())});
+  }
+  this->builder.CreateRetVoid();
+  function->setName(name);
+  return function;
+}
+
+// Blocks nest as deep as the parser allows, so they are walked with an
+// explicit stack rather than by recursion. Their `let`s become allocas in
+// the entry block of the statement's function.
+bool CodeGen::emit_block(NodeId block) {
+  llvm::BasicBlock &entry =
+      this->builder.GetInsertBlock()->getParent()->getEntryBlock();
+  std::vector<std::pair<NodeId, uint32_t>> blocks{{block, 0}};
+  while (!blocks.empty()) {
+    const llvm::ArrayRef<NodeId> statements =
+        this->ast.get_list(blocks.back().first);
+    if (blocks.back().second == statements.size()) {
+      blocks.pop_back();
+      continue;
+    }
+    const NodeId statement = statements[blocks.back().second++];
+
+    switch (this->ast.get_kind(statement)) {
+    case NodeKind::Block:
+      blocks.push_back({statement, 0});
+      break;
+    case NodeKind::Alias:
+      this->skip_alias(statement);
+      break;
+    case NodeKind::Let: {
+      llvm::Value *value =
+          this->emit_expression(this->ast.get_let_init(statement));
+      if (value == nullptr) {
+        return false;
+      }
+      llvm::IRBuilder<> allocas(&entry, entry.begin());
+      llvm::AllocaInst *slot = allocas.CreateAlloca(
+          value->getType(), nullptr,
+          this->interner.get_spelling(this->ast.get_let_name(statement)));
+      this->builder.CreateStore(value, slot);
+      this->storage[this->take_declaration(statement)] = {slot,
+                                                          value->getType()};
+      break;
+    }
+    default:
+      if (this->emit_expression(statement) == nullptr) {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+// Expressions nest as deep as the parser allows, so they are walked with an
+// explicit stack rather than by recursion.
+llvm::Value *CodeGen::emit_expression(NodeId node) {
+  this->frames.clear();
+  this->values.clear();
+  this->frames.push_back({node, 0, nullptr, nullptr});
+
+  while (!this->frames.empty()) {
+    const Frame frame = this->frames.back();
+    const NodeKind kind = this->ast.get_kind(frame.node);
+
+    if (kind == NodeKind::Unary) {
+      if (frame.state == 0) {
+        this->frames.back().state = 1;
+        this->frames.push_back(
+            {this->ast.get_operand(frame.node), 0, nullptr, nullptr});
+        continue;
+      }
+      this->frames.pop_back();
+      llvm::Value *value =
+          this->emit_unary(this->ast.get_op(frame.node), this->values.back());
+      if (value == nullptr) {
+        this->error(CodeGenErrorCode::InvalidOperands, frame.node);
+        return nullptr;
+      }
+      this->values.back() = value;
+      continue;
+    }
+
+    if (kind != NodeKind::Binary) {
+      this->frames.pop_back();
+      if (!this->emit_leaf(frame.node)) {
+        return nullptr;
+      }
+      continue;
+    }
+
+    const Operation op = this->ast.get_op(frame.node);
+    const NodeId lhs = this->ast.get_lhs(frame.node);
+    const NodeId rhs = this->ast.get_rhs(frame.node);
+
+    if (is_assignment(op)) {
+      const Storage target = this->lookup(lhs, /*store=*/true);
+      if (target.pointer == nullptr) {
+        return nullptr;
+      }
+      if (frame.state == 0) {
+        this->frames.back().state = 1;
+        this->frames.push_back({rhs, 0, nullptr, nullptr});
+        continue;
+      }
+      this->frames.pop_back();
+      llvm::Value *value = this->values.back();
+      if (op != Operation::Assign) {
+        llvm::Value *current =
+            this->builder.CreateLoad(target.type, target.pointer);
+        value = this->emit_binary(get_compound_operation(op), current, value);
+        if (value == nullptr) {
+          this->error(CodeGenErrorCode::InvalidOperands, frame.node);
+          return nullptr;
+        }
+      }
+      value = this->widen(value, target.type);
+      if (value == nullptr) {
+        this->error(CodeGenErrorCode::InvalidAssignment, frame.node);
+        return nullptr;
+      }
+      this->builder.CreateStore(value, target.pointer);
+      this->values.back() = value;
+      continue;
+    }
+
+    if (op == Operation::LogicalAnd || op == Operation::LogicalOr) {
+      const bool is_and = op == Operation::LogicalAnd;
+      if (frame.state == 0) {
+        this->frames.back().state = 1;
+        this->frames.push_back({lhs, 0, nullptr, nullptr});
+        continue;
+      }
+      llvm::Value *value = this->to_bool(this->values.back());
+      if (value == nullptr) {
+        this->error(CodeGenErrorCode::InvalidOperands, frame.node);
+        return nullptr;
+      }
+      if (frame.state == 1) {
+        // The right operand only runs if the left one does not decide.
+        llvm::Function *function = this->builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock *next =
+            llvm::BasicBlock::Create(this->context, "rhs", function);
+        llvm::BasicBlock *join =
+            llvm::BasicBlock::Create(this->context, "join", function);
+        llvm::BasicBlock *from = this->builder.GetInsertBlock();
+        this->builder.CreateCondBr(value, is_and ? next : join,
+                                   is_and ? join : next);
+        this->builder.SetInsertPoint(next);
+        this->values.pop_back();
+        this->frames.back() = {frame.node, 2, from, join};
+        this->frames.push_back({rhs, 0, nullptr, nullptr});
+        continue;
+      }
+      this->frames.pop_back();
+      llvm::BasicBlock *rhs_end = this->builder.GetInsertBlock();
+      this->builder.CreateBr(frame.join);
+      this->builder.SetInsertPoint(frame.join);
+      llvm::PHINode *phi =
+          this->builder.CreatePHI(this->builder.getInt1Ty(), 2);
+      phi->addIncoming(this->builder.getInt1(!is_and), frame.from);
+      phi->addIncoming(value, rhs_end);
+      this->values.back() = phi;
+      continue;
+    }
+
+    if (frame.state < 2) {
+      this->frames.back().state = frame.state + 1;
+      this->frames.push_back({frame.state == 0 ? lhs : rhs, 0, nullptr,
+                              nullptr});
+      continue;
+    }
+    this->frames.pop_back();
+    llvm::Value *right = this->values.back();
+    this->values.pop_back();
+    llvm::Value *value = this->emit_binary(op, this->values.back(), right);
+    if (value == nullptr) {
+      this->error(CodeGenErrorCode::InvalidOperands, frame.node);
+      return nullptr;
+    }
+    this->values.back() = value;
+  }
+
+  assert(this->values.size() == 1);
+  return this->values.back();
+}
+
+bool CodeGen::emit_leaf(NodeId node) {
+  llvm::Value *value = nullptr;
+  switch (this->ast.get_kind(node)) {
+  case NodeKind::IntegerLiteral: {
+    // Like wide literals, values past the signed range take an extra bit
+    // that keeps them positive.
+    const uint64_t integer = this->ast.get_integer(node);
+    value = integer <= INT64_MAX ? this->builder.getInt64(integer)
+                                 : llvm::ConstantInt::get(
+                                       this->context, llvm::APInt(65, integer));
+    break;
+  }
+  case NodeKind::WideIntegerLiteral:
+    value = llvm::ConstantInt::get(this->context,
+                                   this->ast.get_wide_integer(node));
+    break;
+  case NodeKind::FloatLiteral:
+    value = llvm::ConstantFP::get(this->builder.getDoubleTy(),
+                                  this->ast.get_float(node));
+    break;
+  case NodeKind::BoolLiteral:
+    value = this->builder.getInt1(this->ast.get_bool(node));
+    break;
+  case NodeKind::StringLiteral:
+    value = this->builder.CreateGlobalString(
+        this->strings[this->ast.get_string_index(node)], ".str");
+    break;
+  case NodeKind::Identifier: {
+    const Storage source = this->lookup(node, /*store=*/false);
+    if (source.pointer == nullptr) {
+      return false;
+    }
+    value = this->builder.CreateLoad(source.type, source.pointer);
+    break;
+  }
+  case NodeKind::Path: {
+    llvm::GlobalVariable *global = this->lookup_import(node);
+    if (global == nullptr) {
+      return false;
+    }
+    value = this->builder.CreateLoad(global->getValueType(), global);
+    break;
+  }
+  default:
+    assert(false && "statement node inside an expression");
+    return false;
+  }
+  this->values.push_back(value);
+  return true;
+}
+
+llvm::Value *CodeGen::emit_binary(Operation op, llvm::Value *lhs,
+                                  llvm::Value *rhs) {
+  if (!this->unify(lhs, rhs)) {
+    return nullptr;
+  }
+  llvm::Type *type = lhs->getType();
+  if (type->isPointerTy()) {
+    return nullptr;
+  }
+  const bool is_float = type->isDoubleTy();
+  const bool boolean = is_bool(type);
+  llvm::IRBuilder<> &b = this->builder;
+
+  switch (op) {
+  case Operation::Add:
+    return is_float ? b.CreateFAdd(lhs, rhs)
+                    : boolean ? nullptr : b.CreateAdd(lhs, rhs);
+  case Operation::Sub:
+    return is_float ? b.CreateFSub(lhs, rhs)
+                    : boolean ? nullptr : b.CreateSub(lhs, rhs);
+  case Operation::Mul:
+    return is_float ? b.CreateFMul(lhs, rhs)
+                    : boolean ? nullptr : b.CreateMul(lhs, rhs);
+  case Operation::Div:
+    return is_float ? b.CreateFDiv(lhs, rhs)
+                    : boolean ? nullptr : b.CreateSDiv(lhs, rhs);
+  case Operation::Rem:
+    return is_float ? b.CreateFRem(lhs, rhs)
+                    : boolean ? nullptr : b.CreateSRem(lhs, rhs);
+  case Operation::BitAnd:
+    return is_float ? nullptr : b.CreateAnd(lhs, rhs);
+  case Operation::BitOr:
+    return is_float ? nullptr : b.CreateOr(lhs, rhs);
+  case Operation::BitXor:
+    return is_float ? nullptr : b.CreateXor(lhs, rhs);
+  case Operation::Shl:
+    return is_float || boolean ? nullptr : b.CreateShl(lhs, rhs);
+  case Operation::Shr:
+    return is_float || boolean ? nullptr : b.CreateAShr(lhs, rhs);
+  case Operation::Eq:
+    return is_float ? b.CreateFCmpOEQ(lhs, rhs) : b.CreateICmpEQ(lhs, rhs);
+  case Operation::Ne:
+    return is_float ? b.CreateFCmpUNE(lhs, rhs) : b.CreateICmpNE(lhs, rhs);
+  // Booleans order false before true.
+  case Operation::Lt:
+    return is_float  ? b.CreateFCmpOLT(lhs, rhs)
+           : boolean ? b.CreateICmpULT(lhs, rhs)
+                     : b.CreateICmpSLT(lhs, rhs);
+  case Operation::Le:
+    return is_float  ? b.CreateFCmpOLE(lhs, rhs)
+           : boolean ? b.CreateICmpULE(lhs, rhs)
+                     : b.CreateICmpSLE(lhs, rhs);
+  case Operation::Gt:
+    return is_float  ? b.CreateFCmpOGT(lhs, rhs)
+           : boolean ? b.CreateICmpUGT(lhs, rhs)
+                     : b.CreateICmpSGT(lhs, rhs);
+  case Operation::Ge:
+    return is_float  ? b.CreateFCmpOGE(lhs, rhs)
+           : boolean ? b.CreateICmpUGE(lhs, rhs)
+                     : b.CreateICmpSGE(lhs, rhs);
+  default:
+    assert(false && "not a plain binary operation");
+    return nullptr;
+  }
+}
+
+llvm::Value *CodeGen::emit_unary(Operation op, llvm::Value *operand) {
+  llvm::Type *type = operand->getType();
+  switch (op) {
+  case Operation::Neg:
+    if (type->isDoubleTy()) {
+      return this->builder.CreateFNeg(operand);
+    }
+    return type->isIntegerTy() && !is_bool(type)
+               ? this->builder.CreateNeg(operand)
+               : nullptr;
+  case Operation::Not: {
+    llvm::Value *value = this->to_bool(operand);
+    return value != nullptr ? this->builder.CreateNot(value) : nullptr;
+  }
+  case Operation::BitNot:
+    return type->isIntegerTy() ? this->builder.CreateNot(operand) : nullptr;
+  default:
+    assert(false && "not a unary operation");
+    return nullptr;
+  }
+}
+
+// Nonzero numbers are true; strings have no truth value.
+llvm::Value *CodeGen::to_bool(llvm::Value *value) {
+  llvm::Type *type = value->getType();
+  if (is_bool(type)) {
+    return value;
+  }
+  if (type->isDoubleTy()) {
+    return this->builder.CreateFCmpUNE(
+        value, llvm::ConstantFP::get(type, 0.0));
+  }
+  if (type->isIntegerTy()) {
+    return this->builder.CreateICmpNE(value,
+                                      llvm::ConstantInt::get(type, 0));
+  }
+  return nullptr;
+}
+
+// Converts `value` to `type` if no value is lost in integer terms: booleans
+// and integers widen to wider integers and to double. Returns nullptr
+// otherwise.
+llvm::Value *CodeGen::widen(llvm::Value *value, llvm::Type *type) {
+  llvm::Type *from = value->getType();
+  if (from == type) {
+    return value;
+  }
+  if (!from->isIntegerTy()) {
+    return nullptr;
+  }
+  if (type->isDoubleTy()) {
+    return is_bool(from) ? this->builder.CreateUIToFP(value, type)
+                         : this->builder.CreateSIToFP(value, type);
+  }
+  if (type->isIntegerTy() &&
+      type->getIntegerBitWidth() > from->getIntegerBitWidth()) {
+    return is_bool(from) ? this->builder.CreateZExt(value, type)
+                         : this->builder.CreateSExt(value, type);
+  }
+  return nullptr;
+}
+
+bool CodeGen::unify(llvm::Value *&lhs, llvm::Value *&rhs) {
+  llvm::Type *a = lhs->getType();
+  llvm::Type *b = rhs->getType();
+  if (a == b) {
+    return true;
+  }
+  llvm::Type *type;
+  if (a->isDoubleTy() || b->isDoubleTy()) {
+    type = this->builder.getDoubleTy();
+  } else if (a->isIntegerTy() && b->isIntegerTy()) {
+    type = a->getIntegerBitWidth() > b->getIntegerBitWidth() ? a : b;
+  } else {
+    return false;
+  }
+  lhs = this->widen(lhs, type);
+  rhs = this->widen(rhs, type);
+  return lhs != nullptr && rhs != nullptr;
+}
+
+llvm::Type *CodeGen::get_type(ValueType type) {
+  switch (type.kind) {
+  case ValueType::Integer:
+    return this->builder.getIntNTy(type.width);
+  case ValueType::Float:
+    return this->builder.getDoubleTy();
+  default:
+    return this->builder.getPtrTy();
+  }
+}
+
+// Imports are read-only and declared on first use.
+CodeGen::Storage CodeGen::lookup(NodeId identifier, bool store) {
+  if (this->ast.get_kind(identifier) != NodeKind::Identifier) {
+    this->error(CodeGenErrorCode::InvalidAssignment, identifier);
+    return {nullptr, nullptr};
+  }
+  const uint32_t index = this->ast.get_declaration(identifier);
+  const Declaration &declaration = this->declarations[index];
+  Storage &target = this->storage[index];
+  if (declaration.kind == Declaration::Import) {
+    if (store) {
+      this->error(CodeGenErrorCode::InvalidAssignment, identifier);
+      return {nullptr, nullptr};
+    }
+    if (target.pointer == nullptr) {
+      llvm::GlobalVariable *global = this->lookup_import(declaration.node);
+      if (global == nullptr) {
+        return {nullptr, nullptr};
+      }
+      target = {global, global->getValueType()};
+    }
+  }
+  assert(target.pointer != nullptr && "use before its declaration");
+  return target;
+}
+
+// Declarations are numbered in source order, the order statements are
+// emitted in.
+uint32_t CodeGen::take_declaration(NodeId node) {
+  assert(this->declarations[this->nextDeclaration].node == node);
+  (void)node;
+  return this->nextDeclaration++;
+}
+
+// Aliases emit nothing; one of a path only numbers its Import.
+void CodeGen::skip_alias(NodeId alias) {
+  const NodeId target = this->ast.get_alias_target(alias);
+  if (this->ast.get_kind(target) == NodeKind::Path) {
+    this->take_declaration(target);
+  }
+}
+
+// Declares the global of an imported export on first use.
+llvm::GlobalVariable *CodeGen::lookup_import(NodeId path) {
+  const Symbol module = this->ast.get_path_module(path);
+  const llvm::StringRef name =
+      this->interner.get_spelling(this->ast.get_path_name(path));
+  auto found = this->imports.find(module.get_raw());
+  const ModuleInterface::Export *symbol =
+      found != this->imports.end() ? found->second->find(name) : nullptr;
+  if (symbol == nullptr) {
+    this->error(CodeGenErrorCode::UnknownExport, path);
+    return nullptr;
+  }
+  const std::string mangled =
+      (this->interner.get_spelling(module) + "." + name).str();
+  if (llvm::GlobalVariable *global = this->module->getNamedGlobal(mangled)) {
+    return global;
+  }
+  return new llvm::GlobalVariable(
+      *this->module, this->get_type(symbol->type), /*isConstant=*/false,
+      llvm::GlobalValue::ExternalLinkage, nullptr, mangled);
+}
@@ -0,0 +1,108 @@
+#ifndef MR_MRC_CODEGEN_H
+#define MR_MRC_CODEGEN_H
+
+#include "AST.h"
+#include "Interner.h"
+#include "ModuleInterface.h"
+#include "ValueType.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class CodeGenErrorCode {
+  NoError = 0,
+  InvalidOperands,
+  InvalidAssignment,
+  UnknownExport,
+};
+
+// Lowers the AST of one file to an llvm::Module.
+//
+// Every `let` becomes an external global `<module>.<name>` of its
+// initializer's type, stored by an internal `<name>.init` function;
+// expression statements and blocks get their own functions too, and a
+// block's `let`s are locals of its function. A module constructor runs
+// them in source order, after the constructors of every module below it in
+// the import graph. Paths load the imported module's global. Names are
+// bound beforehand by the Resolver. Ints are i64, literals past its range
+// one bit wider than their value, floats double, booleans i1 and strings
+// pointers to constant data. Operands of different types are widened to
+// the larger type.
+class CodeGen {
+public:
+  CodeGen(llvm::LLVMContext &context, const Interner &interner,
+          const Ast &ast, llvm::ArrayRef<llvm::StringRef> strings,
+          llvm::ArrayRef<Declaration> declarations,
+          const InterfaceMap &imports);
+
+  // `depth` orders the module constructor, see ModuleInterface. Returns
+  // nullptr at the first error.
+  std::unique_ptr<llvm::Module> generate(llvm::StringRef name, NodeId root,
+                                         uint32_t depth);
+
+  // The globals of the last generated module, in source order.
+  llvm::ArrayRef<ModuleInterface::Export> get_exports() const;
+
+  CodeGenErrorCode get_error() const;
+  // Byte offset of the node that caused the last error.
+  uint32_t get_error_offset() const;
+
+private:
+  // A node on the explicit emission stack; `state` counts the children
+  // already emitted. Logical operators keep the blocks they branch between.
+  struct Frame {
+    NodeId node;
+    uint8_t state;
+    llvm::BasicBlock *from;
+    llvm::BasicBlock *join;
+  };
+
+  // Where the value of a Declaration lives: a global, an alloca or, for
+  // imports, the external global of the export.
+  struct Storage {
+    llvm::Value *pointer;
+    llvm::Type *type;
+  };
+
+  llvm::LLVMContext &context;
+  const Interner &interner;
+  const Ast &ast;
+  llvm::ArrayRef<llvm::StringRef> strings;
+  llvm::ArrayRef<Declaration> declarations;
+  const InterfaceMap &imports;
+  std::unique_ptr<llvm::Module> module;
+  llvm::IRBuilder<> builder;
+  // Indexed like `declarations`.
+  std::vector<Storage> storage;
+  uint32_t nextDeclaration = 0;
+  std::vector<ModuleInterface::Export> exports;
+  std::vector<Frame> frames;
+  std::vector<llvm::Value *> values;
+  CodeGenErrorCode errorCode = CodeGenErrorCode::NoError;
+  uint32_t errorOffset = 0;
+
+  llvm::Function *emit_statement(NodeId statement, uint32_t index);
+  bool emit_block(NodeId block);
+  llvm::Value *emit_expression(NodeId node);
+  bool emit_leaf(NodeId node);
+  llvm::Value *emit_binary(Operation op, llvm::Value *lhs, llvm::Value *rhs);
+  llvm::Value *emit_unary(Operation op, llvm::Value *operand);
+  llvm::Value *to_bool(llvm::Value *value);
+  llvm::Value *widen(llvm::Value *value, llvm::Type *type);
+  bool unify(llvm::Value *&lhs, llvm::Value *&rhs);
+  llvm::Type *get_type(ValueType type);
+  Storage lookup(NodeId identifier, bool store);
+  llvm::GlobalVariable *lookup_import(NodeId path);
+  uint32_t take_declaration(NodeId node);
+  void skip_alias(NodeId alias);
+  void error(CodeGenErrorCode code, NodeId node);
+};
+
+#endif
@@ -0,0 +1,720 @@
+#include "Driver.h"
+
+#include "AstFolder.h"
+#include "CodeGen.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Resolver.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/xxhash.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <system_error>
+
+namespace {
+
+const char *describe(LexerErrorCode code) {
+  switch (code) {
+  case LexerErrorCode::NoError:
+    return "no error";
+  case LexerErrorCode::InvalidHexNumericLiteral:
+    return "invalid hexadecimal literal";
+  case LexerErrorCode::IncompleteExponentLiteral:
+    return "incomplete exponent";
+  case LexerErrorCode::UnterminatedString:
+    return "unterminated string";
+  case LexerErrorCode::UnterminatedHexByte:
+    return "unterminated hex escape";
+  case LexerErrorCode::UnterminatedUnicodeCharacter:
+    return "unterminated unicode escape";
+  case LexerErrorCode::InvalidUtf8:
+    return "invalid UTF-8";
+  }
+  return "unknown error";
+}
+
+const char *describe(ParserErrorCode code) {
+  switch (code) {
+  case ParserErrorCode::NoError:
+    return "no error";
+  case ParserErrorCode::ExpectedExpression:
+    return "expected an expression";
+  case ParserErrorCode::ExpectedRParen:
+    return "expected ')'";
+  case ParserErrorCode::ExpectedIdentifier:
+    return "expected an identifier";
+  case ParserErrorCode::ExpectedEqual:
+    return "expected '='";
+  case ParserErrorCode::ExpectedSemicolon:
+    return "expected ';'";
+  case ParserErrorCode::ExpectedLBrace:
+    return "expected '{'";
+  case ParserErrorCode::ExpectedRBrace:
+    return "expected '}'";
+  case ParserErrorCode::ExpectedColonColon:
+    return "expected '::'";
+  }
+  return "unknown error";
+}
+
+const char *describe(ResolveErrorCode code) {
+  switch (code) {
+  case ResolveErrorCode::NoError:
+    return "no error";
+  case ResolveErrorCode::UndeclaredIdentifier:
+    return "use of undeclared identifier";
+  case ResolveErrorCode::Redefinition:
+    return "redefinition of a name";
+  }
+  return "unknown error";
+}
+
+const char *describe(FoldErrorCode code) {
+  switch (code) {
+  case FoldErrorCode::NoError:
+    return "no error";
+  case FoldErrorCode::IntegerOverflow:
+    return "integer overflow in constant expression";
+  case FoldErrorCode::DivisionByZero:
+    return "division by zero in constant expression";
+  case FoldErrorCode::ShiftOutOfRange:
+    return "shift amount out of range in constant expression";
+  }
+  return "unknown error";
+}
+
+const char *describe(CodeGenErrorCode code) {
+  switch (code) {
+  case CodeGenErrorCode::NoError:
+    return "no error";
+  case CodeGenErrorCode::InvalidOperands:
+    return "invalid operands";
+  case CodeGenErrorCode::InvalidAssignment:
+    return "invalid assignment";
+  case CodeGenErrorCode::UnknownExport:
+    return "no such export in the imported module";
+  }
+  return "unknown error";
+}
+
+// Prints "path:line:column: error: message".
+void report(llvm::raw_ostream &errs, const SourceManager &sm,
+            const fs::path &path, SourceLocation location,
+            const char *message) {
+  const LineColumn position = sm.get_line_column(location);
+  errs << path.string() << ":" << position.line << ":" << position.column
+       << ": error: " << message << "\n";
+}
+
+// a/b/c.mr under `root` is module a.b.c.
+std::string get_module_name(const fs::path &path, const fs::path &root) {
+  std::error_code error;
+  const fs::path relative =
+      fs::absolute(path, error).lexically_normal().lexically_relative(
+          fs::absolute(root, error).lexically_normal());
+  if (relative.empty() || *relative.begin() == "..") {
+    return path.stem().string();
+  }
+  std::string name;
+  for (const fs::path &directory : relative.parent_path()) {
+    name += directory.string();
+    name += '.';
+  }
+  return name + relative.stem().string();
+}
+
+} // namespace
+
+CompilationUnit::CompilationUnit(fs::path path, std::string module)
+    : path(std::move(path)), module(std::move(module)) {}
+
+bool CompilationUnit::compile(SourceManager &sm, Interner &interner,
+                              const ModuleCache *cache) {
+  llvm::raw_string_ostream errs(this->diagnostics);
+
+  llvm::TimeTraceScope trace("Compile", this->path.string());
+
+  std::optional<FileID> file;
+  {
+    PhaseScope scope(&this->times, Phase::Load);
+    file = sm.load_file(this->path, errs);
+  }
+  if (!file) {
+    return false;
+  }
+  this->file = *file;
+
+  const llvm::StringRef buffer = sm.get_buffer(this->file);
+  if (cache != nullptr &&
+      cache->load(buffer, interner, this->entry, this->ast, this->root,
+                  this->strings)) {
+    this->collect_imports();
+    return true;
+  }
+
+  std::optional<Lexer> lexer_storage;
+  {
+    PhaseScope scope(&this->times, Phase::Lex);
+    lexer_storage.emplace(buffer, interner);
+  }
+  Lexer &lexer = *lexer_storage;
+  if (lexer.get_error() == LexerErrorCode::InvalidUtf8) {
+    report(errs, sm, this->path, {this->file, lexer.get_error_offset()},
+           describe(lexer.get_error()));
+    return false;
+  }
+
+  Parser parser(lexer);
+  parser.set_times(&this->times);
+  const PhaseTimes::Time lexed = this->times[Phase::Lex];
+  {
+    PhaseScope scope(&this->times, Phase::Parse);
+    parser.parse();
+  }
+  // The parser pulls its tokens, so lexing ran inside the parse scope.
+  this->times[Phase::Parse].wall -= this->times[Phase::Lex].wall - lexed.wall;
+  this->times[Phase::Parse].cpu -= this->times[Phase::Lex].cpu - lexed.cpu;
+  if (lexer.get_error() != LexerErrorCode::NoError) {
+    report(errs, sm, this->path, {this->file, lexer.get_error_offset()},
+           describe(lexer.get_error()));
+    return false;
+  }
+  if (parser.get_error() != ParserErrorCode::NoError) {
+    report(errs, sm, this->path, {this->file, parser.get_error_offset()},
+           describe(parser.get_error()));
+    return false;
+  }
+
+  this->ast = parser.take_ast();
+  this->root = parser.get_root();
+  this->strings = lexer.take_strings();
+  if (cache != nullptr) {
+    cache->store(buffer, interner, this->ast, this->root,
+                 this->strings.values);
+  }
+  this->collect_imports();
+  return true;
+}
+
+void CompilationUnit::collect_imports() {
+  llvm::DenseSet<uint32_t> seen;
+  this->imports.clear();
+  for (uint32_t i = 0; i < this->ast.size(); ++i) {
+    const NodeId node(i);
+    if (this->ast.get_kind(node) == NodeKind::Path &&
+        seen.insert(this->ast.get_path_module(node).get_raw()).second) {
+      this->imports.push_back(this->ast.get_path_module(node));
+    }
+  }
+}
+
+bool CompilationUnit::generate(const SourceManager &sm,
+                               const Interner &interner,
+                               const InterfaceMap &imports,
+                               const fs::path &output,
+                               const fs::path &interface_path,
+                               const EmitOptions &options,
+                               llvm::ThreadPoolInterface *pool) {
+  llvm::raw_string_ostream errs(this->diagnostics);
+  Resolver resolver(this->ast);
+  {
+    PhaseScope scope(&this->times, Phase::Resolve);
+    if (!resolver.resolve(this->root)) {
+      report(errs, sm, this->path, {this->file, resolver.get_error_offset()},
+             describe(resolver.get_error()));
+      return false;
+    }
+  }
+  {
+    PhaseScope scope(&this->times, Phase::Fold);
+    AstFolder folder(this->ast, interner, imports,
+                     resolver.get_declarations());
+    if (!folder.fold()) {
+      report(errs, sm, this->path, {this->file, folder.get_error_offset()},
+             describe(folder.get_error()));
+      return false;
+    }
+  }
+
+  PhaseScope scope(&this->times, Phase::Codegen);
+
+  std::vector<ModuleInterface::Import> dependencies;
+  uint32_t depth = 0;
+  for (Symbol import : this->imports) {
+    const ModuleInterface *interface = imports.lookup(import.get_raw());
+    dependencies.push_back(
+        {interface->get_name().str(), interface->get_hash()});
+    depth = std::max(depth, interface->get_depth() + 1);
+  }
+
+  llvm::LLVMContext context;
+  CodeGen codegen(context, interner, this->ast, this->strings.values,
+                  resolver.get_declarations(), imports);
+  std::unique_ptr<llvm::Module> module =
+      codegen.generate(this->module, this->root, depth);
+  if (module == nullptr) {
+    report(errs, sm, this->path, {this->file, codegen.get_error_offset()},
+           describe(codegen.get_error()));
+    return false;
+  }
+  module->setSourceFileName(this->path.string());
+  if (!ObjectEmitter::emit(*module, output, options, pool, errs)) {
+    return false;
+  }
+
+  auto interface = std::make_unique<ModuleInterface>(
+      this->module, llvm::xxh3_64bits(sm.get_buffer(this->file)), depth,
+      std::move(dependencies), codegen.get_exports().vec());
+  if (!interface->write(interface_path)) {
+    errs << "Error writing \"" << interface_path.string() << "\"\n";
+    return false;
+  }
+  this->interface = std::move(interface);
+  return true;
+}
+
+void CompilationUnit::reuse_interface(
+    std::unique_ptr<ModuleInterface> interface) {
+  this->interface = std::move(interface);
+}
+
+void CompilationUnit::report_import_error(const SourceManager &sm,
+                                          Symbol module,
+                                          const char *message) {
+  llvm::raw_string_ostream errs(this->diagnostics);
+  for (uint32_t i = 0; i < this->ast.size(); ++i) {
+    const NodeId node(i);
+    if (this->ast.get_kind(node) == NodeKind::Path &&
+        this->ast.get_path_module(node) == module) {
+      report(errs, sm, this->path, {this->file, this->ast.get_offset(node)},
+             message);
+      return;
+    }
+  }
+}
+
+const fs::path &CompilationUnit::get_path() const { return this->path; }
+
+const std::string &CompilationUnit::get_module() const {
+  return this->module;
+}
+
+llvm::ArrayRef<Symbol> CompilationUnit::get_imports() const {
+  return this->imports;
+}
+
+const ModuleInterface *CompilationUnit::get_interface() const {
+  return this->interface.get();
+}
+
+FileID CompilationUnit::get_file() const { return this->file; }
+
+const Ast &CompilationUnit::get_ast() const { return this->ast; }
+
+NodeId CompilationUnit::get_root() const { return this->root; }
+
+const PhaseTimes &CompilationUnit::get_times() const { return this->times; }
+
+llvm::ArrayRef<llvm::StringRef> CompilationUnit::get_strings() const {
+  return this->strings.values;
+}
+
+llvm::StringRef CompilationUnit::get_diagnostics() const {
+  return this->diagnostics;
+}
+
+Driver::Driver(std::vector<fs::path> inputs, DriverOptions options)
+    : options(std::move(options)) {
+  if (!this->options.cache_dir.empty()) {
+    this->cache = std::make_unique<ModuleCache>(this->options.cache_dir);
+  }
+  for (fs::path &input : inputs) {
+    std::string module = get_module_name(input, this->options.module_root);
+    this->add_unit(std::move(input), std::move(module));
+  }
+}
+
+bool Driver::run(llvm::raw_ostream &errs) {
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < this->units.size(); ++i) {
+    const std::string &module = this->units[i]->get_module();
+    if (!this->modules
+             .try_emplace(this->interner.intern(module).get_raw(),
+                          Module{i, nullptr})
+             .second) {
+      errs << "Error: module \"" << module
+           << "\" is given more than once\n";
+      return false;
+    }
+  }
+
+  bool ok = true;
+  uint32_t parsed = 0;
+  while (parsed < this->units.size()) {
+    const uint32_t end = static_cast<uint32_t>(this->units.size());
+    this->parse(parsed, end);
+    for (uint32_t i = parsed; i < end; ++i) {
+      if (!this->graph[i].ready) {
+        ok = false;
+      } else if (this->graph[i].candidate == nullptr &&
+                 !this->options.syntax_only && !this->resolve_imports(i)) {
+        this->graph[i].ready = false;
+        ok = false;
+      }
+    }
+    parsed = end;
+  }
+  if (!this->options.syntax_only) {
+    ok = this->find_cycles() && ok;
+    ok = this->generate_all() && ok;
+  }
+
+  for (const std::unique_ptr<CompilationUnit> &unit : this->units) {
+    errs << unit->get_diagnostics();
+  }
+
+  if (this->options.time_report) {
+    PhaseTimes total;
+    for (const std::unique_ptr<CompilationUnit> &unit : this->units) {
+      total += unit->get_times();
+    }
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    total.print(errs, elapsed.count());
+  }
+  return ok;
+}
+
+uint32_t Driver::add_unit(fs::path path, std::string module) {
+  this->units.push_back(
+      std::make_unique<CompilationUnit>(std::move(path), std::move(module)));
+  this->graph.emplace_back();
+  return static_cast<uint32_t>(this->units.size() - 1);
+}
+
+// Loads, lexes and parses units [begin, end) that have no candidate
+// interface.
+void Driver::parse(uint32_t begin, uint32_t end) {
+  auto compile = [this](uint32_t unit) {
+    Node &node = this->graph[unit];
+    node.ready = node.candidate != nullptr ||
+                 this->units[unit]->compile(this->sm, this->interner,
+                                            this->cache.get());
+  };
+  if (this->options.jobs == 1 || end - begin == 1) {
+    for (uint32_t i = begin; i < end; ++i) {
+      compile(i);
+    }
+    return;
+  }
+  for (uint32_t i = begin; i < end; ++i) {
+    this->async([&compile, i] { compile(i); });
+  }
+  this->pool->wait();
+}
+
+bool Driver::resolve_imports(uint32_t unit) {
+  bool ok = true;
+  for (Symbol module : this->units[unit]->get_imports()) {
+    Module import;
+    if (!this->resolve(module, import)) {
+      this->units[unit]->report_import_error(this->sm, module,
+                                             "module not found");
+      ok = false;
+    } else if (import.unit != NoUnit) {
+      this->add_import(unit, import.unit);
+    }
+  }
+  return ok;
+}
+
+// Finds `module` in the graph, adding it on first use: as a current
+// interface from an earlier run if its source and the interfaces it was
+// compiled against are unchanged, and as a unit otherwise. Returns false
+// if the module has no source.
+bool Driver::resolve(Symbol module, Module &result) {
+  auto found = this->modules.find(module.get_raw());
+  if (found != this->modules.end()) {
+    result = found->second;
+    return true;
+  }
+  const llvm::StringRef name = this->interner.get_spelling(module);
+  fs::path path = this->get_module_path(name);
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> source =
+      llvm::MemoryBuffer::getFile(path.string());
+  if (!source) {
+    return false;
+  }
+  std::unique_ptr<ModuleInterface> interface =
+      ModuleInterface::read(this->get_interface_path(name));
+  if (interface != nullptr &&
+      (interface->get_name() != name ||
+       interface->get_source_hash() !=
+           llvm::xxh3_64bits((*source)->getBuffer()))) {
+    interface = nullptr;
+  }
+
+  // Neither a unit nor an interface until its imports are resolved, which
+  // also makes an import cycle rebuild the module and report the cycle.
+  this->modules[module.get_raw()] = Module();
+  bool rebuild = interface == nullptr;
+  std::vector<uint32_t> pending;
+  for (uint32_t i = 0; !rebuild && i < interface->get_imports().size(); ++i) {
+    const ModuleInterface::Import &import = interface->get_imports()[i];
+    Module dependency;
+    if (!this->resolve(this->interner.intern(import.module), dependency)) {
+      rebuild = true;
+    } else if (dependency.unit != NoUnit) {
+      pending.push_back(dependency.unit);
+    } else {
+      rebuild = dependency.interface == nullptr ||
+                dependency.interface->get_hash() != import.hash;
+    }
+  }
+
+  if (!rebuild && pending.empty()) {
+    this->interfaces.push_back(std::move(interface));
+    result = {NoUnit, this->interfaces.back().get()};
+  } else {
+    result = {this->add_unit(std::move(path), name.str()), nullptr};
+    if (!rebuild) {
+      this->graph[result.unit].candidate = std::move(interface);
+      for (uint32_t import : pending) {
+        this->add_import(result.unit, import);
+      }
+    }
+  }
+  this->modules[module.get_raw()] = result;
+  return true;
+}
+
+void Driver::add_import(uint32_t unit, uint32_t import) {
+  this->graph[unit].imports.push_back(import);
+  this->graph[import].dependents.push_back(unit);
+}
+
+// Null for a unit that has not been generated.
+const ModuleInterface *Driver::get_interface(Symbol module) const {
+  auto found = this->modules.find(module.get_raw());
+  if (found == this->modules.end()) {
+    return nullptr;
+  }
+  const Module &entry = found->second;
+  return entry.unit != NoUnit ? this->units[entry.unit]->get_interface()
+                              : entry.interface;
+}
+
+// Reports every import that closes a cycle. Units on a cycle, and the ones
+// importing them, are never generated.
+bool Driver::find_cycles() {
+  const uint32_t count = static_cast<uint32_t>(this->units.size());
+  std::vector<uint32_t> pending(count);
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < count; ++i) {
+    pending[i] = static_cast<uint32_t>(this->graph[i].imports.size());
+    if (pending[i] == 0) {
+      order.push_back(i);
+    }
+  }
+  for (uint32_t i = 0; i < order.size(); ++i) {
+    for (uint32_t dependent : this->graph[order[i]].dependents) {
+      if (--pending[dependent] == 0) {
+        order.push_back(dependent);
+      }
+    }
+  }
+  if (order.size() == count) {
+    return true;
+  }
+
+  // Whether `unit` is reachable from `from` through imports.
+  llvm::BitVector visited(count);
+  std::vector<uint32_t> stack;
+  auto reaches = [&](uint32_t from, uint32_t unit) {
+    visited.reset();
+    stack.assign(1, from);
+    while (!stack.empty()) {
+      const uint32_t next = stack.back();
+      stack.pop_back();
+      if (next == unit) {
+        return true;
+      }
+      if (!visited.test(next)) {
+        visited.set(next);
+        llvm::append_range(stack, this->graph[next].imports);
+      }
+    }
+    return false;
+  };
+  for (uint32_t i = 0; i < count; ++i) {
+    if (pending[i] == 0) {
+      continue;
+    }
+    this->graph[i].ready = false;
+    for (Symbol module : this->units[i]->get_imports()) {
+      const uint32_t import = this->modules.lookup(module.get_raw()).unit;
+      if (import != NoUnit && reaches(import, i)) {
+        this->units[i]->report_import_error(this->sm, module,
+                                            "import cycle");
+        break;
+      }
+    }
+  }
+  return false;
+}
+
+// Generates every ready unit once all its imports are. A unit that fails
+// holds back everything that imports it.
+bool Driver::generate_all() {
+  const uint32_t count = static_cast<uint32_t>(this->units.size());
+  std::vector<uint32_t> ready;
+  for (uint32_t i = 0; i < count; ++i) {
+    Node &node = this->graph[i];
+    node.pending = static_cast<uint32_t>(node.imports.size());
+    if (node.ready && node.pending == 0) {
+      ready.push_back(i);
+    }
+  }
+
+  std::atomic<bool> ok{true};
+  std::mutex lock;
+  // Returns the dependents the unit made ready.
+  auto generate = [this, &ok, &lock](uint32_t unit) {
+    std::vector<uint32_t> next;
+    if (!this->generate(unit)) {
+      ok.store(false, std::memory_order_relaxed);
+      return next;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    for (uint32_t dependent : this->graph[unit].dependents) {
+      Node &node = this->graph[dependent];
+      if (--node.pending == 0 && node.ready) {
+        next.push_back(dependent);
+      }
+    }
+    return next;
+  };
+
+  if (this->options.jobs == 1 || count == 1) {
+    for (uint32_t i = 0; i < ready.size(); ++i) {
+      llvm::append_range(ready, generate(ready[i]));
+    }
+  } else {
+    std::function<void(uint32_t)> schedule = [this, &generate,
+                                              &schedule](uint32_t unit) {
+      this->async([&generate, &schedule, unit] {
+        for (uint32_t dependent : generate(unit)) {
+          schedule(dependent);
+        }
+      });
+    };
+    for (uint32_t unit : ready) {
+      schedule(unit);
+    }
+    if (this->pool != nullptr) {
+      this->pool->wait();
+    }
+  }
+  return ok.load(std::memory_order_relaxed);
+}
+
+bool Driver::generate(uint32_t unit) {
+  CompilationUnit &compilation = *this->units[unit];
+  Node &node = this->graph[unit];
+  if (node.candidate != nullptr) {
+    bool current = true;
+    for (const ModuleInterface::Import &import :
+         node.candidate->get_imports()) {
+      const ModuleInterface *interface =
+          this->get_interface(this->interner.intern(import.module));
+      current = current && interface->get_hash() == import.hash;
+    }
+    if (current) {
+      compilation.reuse_interface(std::move(node.candidate));
+      return true;
+    }
+    // The source is unchanged, so it imports the same, already generated
+    // modules.
+    node.candidate = nullptr;
+    if (!compilation.compile(this->sm, this->interner, this->cache.get())) {
+      return false;
+    }
+  }
+
+  InterfaceMap imports;
+  for (Symbol module : compilation.get_imports()) {
+    const ModuleInterface *interface = this->get_interface(module);
+    if (interface == nullptr) {
+      compilation.report_import_error(this->sm, module, "module not found");
+      return false;
+    }
+    imports[module.get_raw()] = interface;
+  }
+
+  fs::path output = this->options.output;
+  if (output.empty() || unit != 0) {
+    output = compilation.get_module();
+    output += this->options.emit.kind == OutputKind::LLVMAssembly ? ".ll"
+                                                                  : ".o";
+  }
+  // Partitions share the pool with the units, so that -j bounds both.
+  llvm::ThreadPoolInterface *pool = nullptr;
+  if (this->options.jobs != 1 && this->options.emit.codegen_partitions > 1) {
+    pool = &this->get_pool();
+  }
+  return compilation.generate(
+      this->sm, this->interner, imports, output,
+      this->get_interface_path(compilation.get_module()), this->options.emit,
+      pool);
+}
+
+// Creates the pool on first use, which is always on the main thread: tasks
+// only run once it exists.
+llvm::DefaultThreadPool &Driver::get_pool() {
+  if (this->pool == nullptr) {
+    this->pool = std::make_unique<llvm::DefaultThreadPool>(
+        llvm::hardware_concurrency(this->options.jobs));
+  }
+  return *this->pool;
+}
+
+// Runs `task` on the pool.
+void Driver::async(std::function<void()> task) {
+  this->get_pool().async([this, task = std::move(task)] {
+    // The profiler is per thread. Each task gets its own instance and hands
+    // it over for writing when it is done.
+    if (this->options.time_trace) {
+      llvm::timeTraceProfilerInitialize(this->options.time_trace_granularity,
+                                        "mrc");
+    }
+    task();
+    if (this->options.time_trace) {
+      llvm::timeTraceProfilerFinishThread();
+    }
+  });
+}
+
+fs::path Driver::get_module_path(llvm::StringRef module) const {
+  fs::path path = this->options.module_root;
+  llvm::SmallVector<llvm::StringRef, 4> parts;
+  module.split(parts, '.');
+  for (llvm::StringRef part : parts) {
+    path /= part.str();
+  }
+  path += ".mr";
+  return path.lexically_normal();
+}
+
+fs::path Driver::get_interface_path(llvm::StringRef module) const {
+  return this->options.interface_dir / (module.str() + ".mri");
+}
@@ -0,0 +1,179 @@
+#ifndef MR_MRC_DRIVER_H
+#define MR_MRC_DRIVER_H
+
+#include "AST.h"
+#include "Interner.h"
+#include "ModuleCache.h"
+#include "ModuleInterface.h"
+#include "ObjectEmitter.h"
+#include "SourceManager.h"
+#include "Timing.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One module's source file and everything the driver produced for it.
+class CompilationUnit {
+public:
+  CompilationUnit(fs::path path, std::string module);
+
+  // Loads, lexes and parses the file, or takes its AST from `cache` if the
+  // file is unchanged. Diagnostics are buffered instead of printed so that
+  // units compiled in parallel never interleave output.
+  bool compile(SourceManager &sm, Interner &interner,
+               const ModuleCache *cache);
+
+  // Folds constants in the AST, lowers it to a module in a context of its
+  // own and writes it to `output`, then writes the module's interface to
+  // `interface_path`. `imports` must hold the interface of every module in
+  // get_imports(). Code generation partitions run on `pool` if given. Only
+  // valid after compile() succeeded.
+  bool generate(const SourceManager &sm, const Interner &interner,
+                const InterfaceMap &imports, const fs::path &output,
+                const fs::path &interface_path, const EmitOptions &options,
+                llvm::ThreadPoolInterface *pool);
+
+  // Takes the interface an earlier run wrote instead of compiling again.
+  void reuse_interface(std::unique_ptr<ModuleInterface> interface);
+
+  // Adds `message` to the diagnostics at the first path into `module`.
+  void report_import_error(const SourceManager &sm, Symbol module,
+                           const char *message);
+
+  // Time spent in each phase of compile() and generate(). Parse excludes
+  // lexing.
+  const PhaseTimes &get_times() const;
+
+  const fs::path &get_path() const;
+  const std::string &get_module() const;
+  // The modules the AST has paths into, in order of first use.
+  llvm::ArrayRef<Symbol> get_imports() const;
+  // Null until generate() or reuse_interface().
+  const ModuleInterface *get_interface() const;
+  FileID get_file() const;
+  const Ast &get_ast() const;
+  NodeId get_root() const;
+  // Decoded String literals, indexed by StringLiteral nodes. Most point into
+  // the file's buffer or the unit's cache entry.
+  llvm::ArrayRef<llvm::StringRef> get_strings() const;
+  llvm::StringRef get_diagnostics() const;
+
+private:
+  fs::path path;
+  std::string module;
+  FileID file;
+  // The cache entry the AST and strings view, if they were loaded.
+  ModuleCache::Entry entry;
+  Ast ast;
+  NodeId root;
+  StringTable strings;
+  std::vector<Symbol> imports;
+  std::unique_ptr<ModuleInterface> interface;
+  std::string diagnostics;
+  PhaseTimes times;
+
+  void collect_imports();
+};
+
+struct DriverOptions {
+  // Number of worker threads; 0 uses every hardware thread.
+  unsigned jobs = 0;
+  // Empty to disable the module cache.
+  fs::path cache_dir;
+  // Print PhaseTimes summed over all units after the run.
+  bool time_report = false;
+  // Record time-trace events on the worker threads too. The caller owns
+  // the profiler on the main thread and writes the trace.
+  bool time_trace = false;
+  unsigned time_trace_granularity = 500;
+  // Stop after parsing the inputs.
+  bool syntax_only = false;
+  EmitOptions emit;
+  // Only valid with a single input. Empty to write <module>.o (or .ll) to
+  // the current directory.
+  fs::path output;
+  // Paths into module a.b.c resolve to <module_root>/a/b/c.mr. Inputs under
+  // it are named after their path relative to it, others after their stem.
+  fs::path module_root = ".";
+  // Where module interfaces are written and looked up.
+  fs::path interface_dir = ".";
+};
+
+// Compiles input files and the modules they import on a thread pool.
+//
+// Inputs are parsed first, then the modules they import, wave by wave,
+// until the import graph is complete. Modules are then generated in
+// topological order: a module starts as soon as the last of its imports has
+// written its interface, so independent modules run concurrently.
+//
+// Imported modules that are not inputs are only compiled if their interface
+// is out of date. A module whose source is unchanged but whose imports are
+// rebuilt waits for them and is compiled only if one of their interfaces
+// changed, so an edit stops propagating at the first module whose exports
+// stay the same. Diagnostics are written in input order regardless of
+// which file finishes first.
+class Driver {
+public:
+  Driver(std::vector<fs::path> inputs, DriverOptions options);
+
+  // Returns false if any unit failed.
+  bool run(llvm::raw_ostream &errs);
+
+private:
+  static constexpr uint32_t NoUnit = UINT32_MAX;
+
+  // A module of the import graph: compiled by a unit in this run, or known
+  // only by a current interface from an earlier one.
+  struct Module {
+    uint32_t unit = NoUnit;
+    const ModuleInterface *interface = nullptr;
+  };
+
+  // The edges of a unit in the import graph, parallel to `units`.
+  struct Node {
+    // Units it imports, which must be generated first.
+    std::vector<uint32_t> imports;
+    std::vector<uint32_t> dependents;
+    // Imports not generated yet, while scheduling.
+    uint32_t pending = 0;
+    // Parsed and with every import resolved.
+    bool ready = false;
+    // The interface an earlier run wrote for an unchanged source, reused if
+    // the imports come out the same. The unit is parsed only if not.
+    std::unique_ptr<ModuleInterface> candidate;
+  };
+
+  SourceManager sm;
+  Interner interner;
+  std::unique_ptr<ModuleCache> cache;
+  std::vector<std::unique_ptr<CompilationUnit>> units;
+  std::vector<Node> graph;
+  // By the Symbol of the module name.
+  llvm::DenseMap<uint32_t, Module> modules;
+  // Current interfaces read from disk.
+  std::vector<std::unique_ptr<ModuleInterface>> interfaces;
+  std::unique_ptr<llvm::DefaultThreadPool> pool;
+  DriverOptions options;
+
+  uint32_t add_unit(fs::path path, std::string module);
+  void parse(uint32_t begin, uint32_t end);
+  bool resolve_imports(uint32_t unit);
+  bool resolve(Symbol module, Module &result);
+  void add_import(uint32_t unit, uint32_t import);
+  const ModuleInterface *get_interface(Symbol module) const;
+  bool find_cycles();
+  bool generate_all();
+  bool generate(uint32_t unit);
+  llvm::DefaultThreadPool &get_pool();
+  void async(std::function<void()> task);
+  fs::path get_module_path(llvm::StringRef module) const;
+  fs::path get_interface_path(llvm::StringRef module) const;
+};
+
+#endif
@@ -0,0 +1,157 @@
+#include "Interner.h"
+
+#include "llvm/Support/xxhash.h"
+
+#include <cassert>
+#include <cstring>
+
+static constexpr size_t InitialShardCapacity = 256;
+
+Interner::Table::Table(size_t capacity)
+    : mask(capacity - 1),
+      slots(std::make_unique<std::atomic<const Entry *>[]>(capacity)) {
+  assert((capacity & (capacity - 1)) == 0 && "capacity must be a power of 2");
+  for (size_t i = 0; i < capacity; ++i) {
+    this->slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+Interner::Interner() {
+  for (std::atomic<std::atomic<const Entry **> *> &page : this->directory) {
+    page.store(nullptr, std::memory_order_relaxed);
+  }
+  for (Shard &shard : this->shards) {
+    shard.tables.push_back(std::make_unique<Table>(InitialShardCapacity));
+    shard.table.store(shard.tables.back().get(), std::memory_order_release);
+  }
+}
+
+Interner::~Interner() {
+  for (std::atomic<std::atomic<const Entry **> *> &slot : this->directory) {
+    std::atomic<const Entry **> *page = slot.load(std::memory_order_relaxed);
+    if (page == nullptr) {
+      continue;
+    }
+    for (uint32_t i = 0; i < PageSize; ++i) {
+      delete[] page[i].load(std::memory_order_relaxed);
+    }
+    delete[] page;
+  }
+}
+
+const Interner::Entry *Interner::find(const Table *table, uint64_t hash,
+                                      llvm::StringRef spelling) {
+  for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    const Entry *entry = table->slots[i].load(std::memory_order_acquire);
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    if (entry->hash == hash && entry->length == spelling.size() &&
+        std::memcmp(entry->data, spelling.data(), spelling.size()) == 0) {
+      return entry;
+    }
+  }
+}
+
+void Interner::insert(Table *table, const Entry *entry) {
+  size_t i = entry->hash & table->mask;
+  while (table->slots[i].load(std::memory_order_relaxed) != nullptr) {
+    i = (i + 1) & table->mask;
+  }
+  table->slots[i].store(entry, std::memory_order_release);
+}
+
+void Interner::grow(Shard &shard) {
+  const Table *old = shard.table.load(std::memory_order_relaxed);
+  auto table = std::make_unique<Table>((old->mask + 1) * 2);
+  for (size_t i = 0; i <= old->mask; ++i) {
+    if (const Entry *entry = old->slots[i].load(std::memory_order_relaxed)) {
+      insert(table.get(), entry);
+    }
+  }
+  shard.table.store(table.get(), std::memory_order_release);
+  shard.tables.push_back(std::move(table));
+}
+
+void Interner::publish(const Entry *entry) {
+  const uint32_t id = entry->symbol.get_raw();
+  std::atomic<std::atomic<const Entry **> *> &page_slot =
+      this->directory[id >> (ChunkBits + PageBits)];
+  std::atomic<const Entry **> *page =
+      page_slot.load(std::memory_order_acquire);
+  const Entry **chunk =
+      page != nullptr
+          ? page[(id >> ChunkBits) & (PageSize - 1)].load(
+                std::memory_order_acquire)
+          : nullptr;
+  if (chunk == nullptr) {
+    std::lock_guard<std::mutex> guard(this->directory_lock);
+    page = page_slot.load(std::memory_order_relaxed);
+    if (page == nullptr) {
+      page = new Page;
+      for (uint32_t i = 0; i < PageSize; ++i) {
+        page[i].store(nullptr, std::memory_order_relaxed);
+      }
+      page_slot.store(page, std::memory_order_release);
+    }
+    std::atomic<const Entry **> &chunk_slot =
+        page[(id >> ChunkBits) & (PageSize - 1)];
+    chunk = chunk_slot.load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+      chunk = new Chunk();
+      chunk_slot.store(chunk, std::memory_order_release);
+    }
+  }
+  chunk[id & (ChunkSize - 1)] = entry;
+}
+
+Symbol Interner::intern(llvm::StringRef spelling) {
+  const uint64_t hash = llvm::xxh3_64bits(spelling);
+  Shard &shard = this->shards[hash >> (64 - ShardBits)];
+
+  if (const Entry *entry = find(shard.table.load(std::memory_order_acquire),
+                                hash, spelling)) {
+    return entry->symbol;
+  }
+
+  std::lock_guard<std::mutex> guard(shard.lock);
+  if (const Entry *entry = find(shard.table.load(std::memory_order_relaxed),
+                                hash, spelling)) {
+    return entry->symbol;
+  }
+
+  Table *table = shard.table.load(std::memory_order_relaxed);
+  if ((shard.count + 1) * 4 > (table->mask + 1) * 3) {
+    this->grow(shard);
+    table = shard.table.load(std::memory_order_relaxed);
+  }
+
+  const uint32_t id = this->next_symbol.fetch_add(1, std::memory_order_relaxed);
+  assert(id != Symbol::Invalid && "symbol space exhausted");
+
+  char *data = shard.arena.Allocate<char>(spelling.size());
+  std::memcpy(data, spelling.data(), spelling.size());
+  const Entry *entry = new (shard.arena.Allocate<Entry>())
+      Entry{hash, data, static_cast<uint32_t>(spelling.size()), Symbol(id)};
+
+  this->publish(entry);
+  insert(table, entry);
+  ++shard.count;
+  return entry->symbol;
+}
+
+llvm::StringRef Interner::get_spelling(Symbol symbol) const {
+  assert(symbol.is_valid() && symbol.get_raw() < this->size());
+  const uint32_t id = symbol.get_raw();
+  const std::atomic<const Entry **> *page =
+      this->directory[id >> (ChunkBits + PageBits)].load(
+          std::memory_order_acquire);
+  const Entry *const *chunk =
+      page[(id >> ChunkBits) & (PageSize - 1)].load(std::memory_order_acquire);
+  const Entry *entry = chunk[id & (ChunkSize - 1)];
+  return llvm::StringRef(entry->data, entry->length);
+}
+
+uint32_t Interner::size() const {
+  return this->next_symbol.load(std::memory_order_relaxed);
+}
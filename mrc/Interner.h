@@ -0,0 +1,108 @@
+#ifndef MR_MRC_INTERNER_H
+#define MR_MRC_INTERNER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A dense id for an interned identifier. Two symbols from the same Interner
+// are equal exactly when their spellings are.
+class Symbol {
+public:
+  static constexpr uint32_t Invalid = UINT32_MAX;
+
+  Symbol() = default;
+  explicit Symbol(uint32_t id) : id(id) {}
+
+  bool is_valid() const { return this->id != Invalid; }
+  uint32_t get_raw() const { return this->id; }
+
+  bool operator==(const Symbol &other) const { return this->id == other.id; }
+  bool operator!=(const Symbol &other) const { return this->id != other.id; }
+  bool operator<(const Symbol &other) const { return this->id < other.id; }
+
+private:
+  uint32_t id = Invalid;
+};
+
+namespace std {
+template <> struct hash<Symbol> {
+  size_t operator()(const Symbol &symbol) const { return symbol.get_raw(); }
+};
+} // namespace std
+
+// Maps identifier spellings to Symbols. Lookups of already interned names
+// take no locks, so one Interner can be shared by several lexer threads;
+// inserts lock only the shard the name hashes to. Spellings are copied once
+// into a per-shard arena and live as long as the Interner.
+class Interner {
+public:
+  Interner();
+  ~Interner();
+  Interner(const Interner &) = delete;
+  Interner &operator=(const Interner &) = delete;
+
+  Symbol intern(llvm::StringRef spelling);
+  llvm::StringRef get_spelling(Symbol symbol) const;
+  uint32_t size() const;
+
+private:
+  struct Entry {
+    uint64_t hash;
+    const char *data;
+    uint32_t length;
+    Symbol symbol;
+  };
+
+  struct Table {
+    explicit Table(size_t capacity);
+
+    size_t mask;
+    std::unique_ptr<std::atomic<const Entry *>[]> slots;
+  };
+
+  struct alignas(64) Shard {
+    std::atomic<Table *> table{nullptr};
+    std::mutex lock;
+    size_t count = 0;
+    llvm::BumpPtrAllocator arena;
+    // Superseded tables stay alive so that lock-free readers never probe
+    // freed memory.
+    std::vector<std::unique_ptr<Table>> tables;
+  };
+
+  static constexpr unsigned ShardBits = 4;
+  static constexpr unsigned ChunkBits = 12;
+  static constexpr uint32_t ChunkSize = 1u << ChunkBits;
+  static constexpr unsigned PageBits = 10;
+  static constexpr uint32_t PageSize = 1u << PageBits;
+  static constexpr uint32_t MaxPages = 1u << (32 - ChunkBits - PageBits);
+
+  using Chunk = const Entry *[ChunkSize];
+  using Page = std::atomic<const Entry **>[PageSize];
+
+  std::array<Shard, 1u << ShardBits> shards;
+  std::atomic<uint32_t> next_symbol{0};
+
+  // Symbol -> entry, in fixed-size chunks so that growing never moves
+  // entries other threads may be reading. The directory of chunks has two
+  // levels, and both pages and chunks are allocated as symbols reach them.
+  std::array<std::atomic<std::atomic<const Entry **> *>, MaxPages>
+      directory;
+  std::mutex directory_lock;
+
+  static const Entry *find(const Table *table, uint64_t hash,
+                           llvm::StringRef spelling);
+  static void insert(Table *table, const Entry *entry);
+  void grow(Shard &shard);
+  void publish(const Entry *entry);
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MR_MRC_KEYWORDS_H
+#define MR_MRC_KEYWORDS_H
+
+#include "Lexer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Keyword recognition through a perfect hash that is built at compile time
+// from KeywordList. A new keyword only needs an entry in the list.
+class Keywords {
+public:
+  struct Keyword {
+    std::string_view spelling;
+    TokenKind kind;
+  };
+
+  static constexpr Keyword KeywordList[] = {
+      {"true", TokenKind::True}, {"false", TokenKind::False},
+      {"let", TokenKind::Let},   {"type", TokenKind::Type},
+      {"func", TokenKind::Func},
+  };
+
+  // Returns the keyword kind for the identifier spelled by `data`, or
+  // TokenKind::Identifier if it is not a keyword.
+  static constexpr TokenKind classify(const char *data, size_t length) {
+    if (length == 0) {
+      return TokenKind::Identifier;
+    }
+    const Keyword &candidate = Table.slots[slot(Table.seed, data, length)];
+    if (candidate.spelling == std::string_view(data, length)) {
+      return candidate.kind;
+    }
+    return TokenKind::Identifier;
+  }
+
+  static constexpr TokenKind classify(std::string_view spelling) {
+    return classify(spelling.data(), spelling.size());
+  }
+
+private:
+  static constexpr uint32_t TableBits = 4;
+  static constexpr uint32_t TableSize = 1u << TableBits;
+
+  static_assert(std::size(KeywordList) <= TableSize,
+                "grow TableBits to fit the keyword list");
+
+  struct HashTable {
+    uint32_t seed = 0;
+    Keyword slots[TableSize] = {};
+  };
+
+  // Keys on the first two characters, the last one and the length, which is
+  // enough to tell the keywords apart.
+  static constexpr uint32_t slot(uint32_t seed, const char *data,
+                                 size_t length) {
+    const uint32_t key = static_cast<uint8_t>(data[0]) |
+                         static_cast<uint8_t>(data[length > 1]) << 8 |
+                         static_cast<uint8_t>(data[length - 1]) << 16 |
+                         static_cast<uint32_t>(length) << 24;
+    return (key * seed) >> (32 - TableBits);
+  }
+
+  // Tries odd multipliers until every keyword lands in its own slot.
+  static constexpr HashTable build() {
+    for (uint32_t seed = 1; seed < 0x10000; seed += 2) {
+      HashTable table{seed, {}};
+      bool collision = false;
+      for (const Keyword &keyword : KeywordList) {
+        Keyword &entry =
+            table.slots[slot(seed, keyword.spelling.data(),
+                             keyword.spelling.size())];
+        if (!entry.spelling.empty()) {
+          collision = true;
+          break;
+        }
+        entry = keyword;
+      }
+      if (!collision) {
+        return table;
+      }
+    }
+    return HashTable{};
+  }
+
+  static const HashTable Table;
+};
+
+inline constexpr Keywords::HashTable Keywords::Table = Keywords::build();
+
+// Every keyword classifies as its own kind, while neither a proper prefix
+// nor a one-character extension of a keyword is classified as one.
+static_assert(
+    [] {
+      for (const Keywords::Keyword &keyword : Keywords::KeywordList) {
+        const std::string_view spelling = keyword.spelling;
+        if (Keywords::classify(spelling) != keyword.kind) {
+          return false;
+        }
+        if (Keywords::classify(spelling.substr(0, spelling.size() - 1)) !=
+            TokenKind::Identifier) {
+          return false;
+        }
+        char extended[32] = {};
+        for (size_t i = 0; i < spelling.size(); ++i) {
+          extended[i] = spelling[i];
+        }
+        extended[spelling.size()] = spelling.back();
+        if (Keywords::classify(extended, spelling.size() + 1) !=
+            TokenKind::Identifier) {
+          return false;
+        }
+      }
+      return true;
+    }(),
+    "keyword hash table disagrees with Keywords::KeywordList");
+
+#endif
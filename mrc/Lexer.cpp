@@ -1,33 +1,25 @@
 #include "Lexer.h"
+#include "CharScan.h"
+#include "Keywords.h"
 #include "LexerUtil.h"
+#include "NumberUtil.h"
 #include "StringUtil.h"
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+#include <cassert>
 #include <cstdint>
+#include <algorithm>
 #include <cstdio>
-#include <fstream>
-#include <ios>
 #include <iostream>
 #include <memory>
-#include <sstream>
 #include <string>
-#include <unordered_map>
-
-const std::unordered_map<std::string, TokenKind> Lexer::Keywords = {
-    {"true", TokenKind::True},
-    {"false", TokenKind::False},
-		{"let", TokenKind::Let},
-		{"type", TokenKind::Type},
-		{"func", TokenKind::Func},
-};
-
-Token::Token(TokenKind kind) : kind(kind), literal({}) {};
-Token::Token(TokenKind kind, std::string literal)
-    : kind(kind), literal(literal) {};
 
 #define CASE(KIND, STR)                                                        \
   case TokenKind::KIND:                                                        \
     return std::string(u8##STR)
 
-std::string Token::to_str() const {
+std::string Token::to_str(llvm::StringRef source) const {
   switch (this->kind) {
     CASE(Plus, "<'+'>");
     CASE(Minus, "<'-'>");
@@ -52,6 +44,8 @@ std::string Token::to_str() const {
     CASE(Comma, "<','>");
     CASE(Colon, "<':'>");
     CASE(Semicolon, "<';'>");
+    CASE(ColonColon, "<'::'>");
+    CASE(At, "<'@'>");
 
     CASE(PlusPlus, "<'++'>");
     CASE(MinusMinus, "<'--'>");
@@ -87,14 +81,15 @@ std::string Token::to_str() const {
 
   case TokenKind::Numeric: {
     std::string rv = "<num:";
-    rv.append(this->literal);
+    rv.append(this->to_strref(source).str());
     rv.push_back('>');
     return rv;
   }
 
   case TokenKind::String: {
     std::string rv = "<str:";
-    const std::string escaped = StringUtil::escape_string(this->literal);
+    const std::string escaped =
+        StringUtil::escape_string(this->to_strref(source).str());
     rv.append(escaped);
     rv.push_back('>');
     return rv;
@@ -102,7 +97,7 @@ std::string Token::to_str() const {
 
   case TokenKind::Identifier: {
     std::string rv = "<id:";
-    rv.append(this->literal);
+    rv.append(this->to_strref(source).str());
     rv.push_back('>');
     return rv;
   }
@@ -113,307 +108,537 @@ std::string Token::to_str() const {
 }
 #undef CASE
 
-llvm::StringRef Token::to_strref() const {
-	return this->literal;
+llvm::StringRef Token::to_strref(llvm::StringRef source) const {
+  return source.substr(this->offset, this->length);
+}
+
+std::unique_ptr<Lexer> Lexer::from_file(SourceManager &sm, Interner &interner,
+                                        fs::path path) {
+  std::optional<FileID> file = sm.load_file(path);
+  if (!file) {
+    return nullptr;
+  }
+  return std::make_unique<Lexer>(sm.get_buffer(*file), interner);
+}
+
+namespace {
+
+// Input proven to be pure ASCII: every byte is a whole code point.
+struct AsciiEncoding {
+  static constexpr bool MultiByte = false;
+
+  static uint32_t decode(const char *&, uint8_t first) { return first; }
+};
+
+// Input proven to be well-formed UTF-8.
+struct Utf8Encoding {
+  static constexpr bool MultiByte = true;
+
+  static uint32_t decode(const char *&cur, uint8_t first) {
+    return StringUtil::utf8_from_buffer(cur, first);
+  }
+};
+
+} // namespace
+
+// The whole buffer is validated once up front, so the token loop never sees
+// ill-formed UTF-8 and ASCII files can skip multi-byte decoding entirely.
+// On invalid input only the valid prefix is lexed.
+Lexer::Lexer(llvm::StringRef buffer, Interner &interner)
+    : interner(interner) {
+  this->load(buffer);
+}
+
+void Lexer::load(llvm::StringRef buffer) {
+  this->buffer = buffer;
+  this->_start = buffer.begin();
+  this->_cur = buffer.begin();
+  this->_end = buffer.end();
+  this->errorCode = LexerErrorCode::NoError;
+  this->errorOffset = 0;
+
+  bool ascii = true;
+  const char *valid_end = CharScan::validate_utf8(this->_cur, this->_end, ascii);
+  if (valid_end != this->_end) {
+    this->errorCode = LexerErrorCode::InvalidUtf8;
+    this->errorOffset = static_cast<uint32_t>(valid_end - this->_start);
+    this->_end = valid_end;
+  }
+
+  if (ascii) {
+    this->lex_token = &Lexer::lex_next<AsciiEncoding>;
+  } else {
+    this->lex_token = &Lexer::lex_next<Utf8Encoding>;
+  }
+}
+
+// Checks the bytes an edit inserted, widened to whole code points, and
+// switches to multi-byte decoding if they are not all ASCII.
+bool Lexer::validate_edit(const char *begin, const char *end) {
+  // Bytes before the edit are unchanged, so the code point that may straddle
+  // it starts at most three bytes earlier.
+  const char *edit_begin = begin;
+  begin = std::max(this->_start, begin - 3);
+  while (begin < edit_begin && (static_cast<uint8_t>(*begin) & 0xC0) == 0x80) {
+    ++begin;
+  }
+  while (end < this->_end && (static_cast<uint8_t>(*end) & 0xC0) == 0x80) {
+    ++end;
+  }
+  bool ascii = true;
+  if (CharScan::validate_utf8(begin, end, ascii) != end) {
+    return false;
+  }
+  if (!ascii) {
+    this->lex_token = &Lexer::lex_next<Utf8Encoding>;
+  }
+  return true;
 }
 
-std::unique_ptr<Lexer> Lexer::from_file(fs::path path) {
-  return std::make_unique<Lexer>(std::ifstream(path));
+// The lexer looks at no more than one code point past the end of a token,
+// so a token is reused only if that many bytes separate it from the next
+// edit. Lexing restarts right after the last reused token and stops at the
+// first new token that starts where an old one did: from there on the input
+// and thus the tokens are the same as before, only shifted.
+std::vector<Token> Lexer::relex(llvm::StringRef buffer,
+                                llvm::ArrayRef<Token> tokens,
+                                llvm::ArrayRef<TextEdit> edits) {
+  constexpr int64_t Margin = 4;
+
+  assert(!tokens.empty() && tokens.back().kind == TokenKind::Eof);
+  const llvm::StringRef old_buffer = this->buffer;
+  // The values are rebuilt from the tokens that are kept, so that those of
+  // replaced tokens do not pile up from edit to edit.
+  StringTable old_strings = std::move(this->strings);
+  this->strings = StringTable();
+  std::vector<NumericValue> old_numerics = std::move(this->numerics);
+  this->numerics.clear();
+  std::vector<llvm::APInt> old_wide_integers = std::move(this->wide_integers);
+  this->wide_integers.clear();
+  this->buffer = buffer;
+  this->_start = buffer.begin();
+  this->_end = buffer.end();
+  this->errorCode = LexerErrorCode::NoError;
+  this->errorOffset = 0;
+
+  // Edit bounds in new buffer offsets.
+  std::vector<int64_t> new_start(edits.size());
+  std::vector<int64_t> new_end(edits.size());
+  int64_t shift = 0;
+  for (size_t i = 0; i < edits.size(); ++i) {
+    assert((i == 0 || edits[i - 1].offset + edits[i - 1].length <=
+                          edits[i].offset) &&
+           "edits must be sorted and non-overlapping");
+    new_start[i] = edits[i].offset + shift;
+    new_end[i] = new_start[i] + edits[i].text.size();
+    shift += static_cast<int64_t>(edits[i].text.size()) - edits[i].length;
+    if (!this->validate_edit(this->_start + new_start[i],
+                             this->_start + new_end[i])) {
+      this->load(buffer);
+      return this->lex();
+    }
+  }
+  // A stream cut short by invalid UTF-8 has nothing to line up with.
+  if (tokens.back().offset + shift != static_cast<int64_t>(buffer.size())) {
+    this->load(buffer);
+    return this->lex();
+  }
+
+  // Kept tokens take their values along into the new tables. String values
+  // that are spans of the old buffer move with their tokens; decoded ones
+  // are copied into the new arena.
+  auto reuse = [&](std::vector<Token> &result, size_t begin, size_t end,
+                   int64_t delta) {
+    const size_t first = result.size();
+    result.insert(result.end(), tokens.begin() + begin, tokens.begin() + end);
+    for (size_t i = first; i < result.size(); ++i) {
+      Token &token = result[i];
+      token.offset = static_cast<uint32_t>(token.offset + delta);
+      if (token.kind == TokenKind::String) {
+        assert(token.payload < old_strings.values.size() &&
+               "relex cannot follow take_strings()");
+        llvm::StringRef value = old_strings.values[token.payload];
+        if (value.data() >= old_buffer.begin() &&
+            value.data() <= old_buffer.end()) {
+          value = llvm::StringRef(
+              this->_start + (value.data() - old_buffer.begin()) + delta,
+              value.size());
+        } else {
+          value = this->strings.save(value);
+        }
+        token.payload = static_cast<uint32_t>(this->strings.values.size());
+        this->strings.values.push_back(value);
+      } else if (token.kind == TokenKind::Numeric) {
+        NumericValue value = old_numerics[token.payload];
+        if (value.kind == NumericValue::WideInteger) {
+          this->wide_integers.push_back(old_wide_integers[value.bits]);
+          value.bits = this->wide_integers.size() - 1;
+        }
+        token.payload = static_cast<uint32_t>(this->numerics.size());
+        this->numerics.push_back(value);
+      }
+    }
+  };
+
+  std::vector<Token> result;
+  result.reserve(tokens.size());
+  size_t old = 0;
+  size_t edit = 0;
+  int64_t delta = 0;
+
+  while (true) {
+    // Reuse old tokens up to the next edit.
+    if (edit == edits.size()) {
+      reuse(result, old, tokens.size(), delta);
+      return result;
+    }
+    const int64_t limit = new_start[edit];
+    const size_t begin = old;
+    while (tokens[old].kind != TokenKind::Eof &&
+           tokens[old].offset + delta + tokens[old].length + Margin <= limit) {
+      ++old;
+    }
+    reuse(result, begin, old, delta);
+    while (!result.empty() &&
+           result.back().offset + result.back().length + Margin > limit) {
+      result.pop_back();
+    }
+
+    // Lex until the new tokens line up with the old ones again.
+    const size_t first_edit = edit;
+    this->_cur = this->_start;
+    if (!result.empty()) {
+      this->_cur += result.back().offset + result.back().length;
+    }
+    while (true) {
+      const Token token = this->next();
+      if (token.kind == TokenKind::Eof) {
+        result.push_back(token);
+        return result;
+      }
+      while (edit < edits.size() && token.offset >= new_end[edit]) {
+        delta += static_cast<int64_t>(edits[edit].text.size()) -
+                 edits[edit].length;
+        ++edit;
+      }
+      if (edit > first_edit && token.offset >= new_end[edit - 1] &&
+          (edit == edits.size() || token.offset < new_start[edit])) {
+        const int64_t offset = token.offset - delta;
+        while (tokens[old].kind != TokenKind::Eof &&
+               tokens[old].offset < offset) {
+          ++old;
+        }
+        if (tokens[old].offset == offset) {
+          break;
+        }
+      }
+      result.push_back(token);
+    }
+  }
 }
 
-Lexer::Lexer(std::ifstream file) {
-  this->_fd = std::move(file);
-  if (!this->_fd.is_open()) {
-    std::cerr << "Error opening the file!";
-    return;
+llvm::StringRef Lexer::get_buffer() const { return this->buffer; }
+
+Interner &Lexer::get_interner() const { return this->interner; }
+
+llvm::StringRef StringTable::save(llvm::StringRef value) {
+  if (value.empty()) {
+    return llvm::StringRef();
   }
+  char *copy = this->arena.Allocate<char>(value.size());
+  std::copy(value.begin(), value.end(), copy);
+  return llvm::StringRef(copy, value.size());
+}
+
+llvm::StringRef Lexer::get_string(const Token &token) const {
+  return this->strings.values[token.payload];
+}
+
+StringTable Lexer::take_strings() {
+  StringTable strings = std::move(this->strings);
+  this->strings = StringTable();
+  return strings;
+}
+
+const NumericValue &Lexer::get_numeric(const Token &token) const {
+  return this->numerics[token.payload];
+}
+
+const llvm::APInt &Lexer::get_wide_integer(const NumericValue &value) const {
+  return this->wide_integers[value.bits];
+}
+
+Symbol Lexer::get_symbol(const Token &token) const {
+  return Symbol(token.payload);
+}
 
-  this->_fd.seekg(0, std::ios::end);
-  this->_fsize = this->_fd.tellg();
-  this->_fd.seekg(0, std::ios::beg);
+LexerErrorCode Lexer::get_error() const { return this->errorCode; }
+
+uint32_t Lexer::get_error_offset() const { return this->errorOffset; }
+
+void Lexer::error(LexerErrorCode code) {
+  this->errorCode = code;
+  this->errorOffset = static_cast<uint32_t>(this->_cur - this->_start);
+}
+
+bool Lexer::eof() const { return this->_cur >= this->_end; }
+
+uint32_t Lexer::peek() const { return this->peek(0); }
+
+uint32_t Lexer::peek(uint32_t next) const {
+  if (this->_end - this->_cur <= next) {
+    return (uint32_t)EOF;
+  }
+  return static_cast<uint8_t>(this->_cur[next]);
 }
 
-Lexer::~Lexer() {
-  if (this->_fd.is_open())
-    this->_fd.close();
+uint32_t Lexer::get() {
+  if (this->eof()) {
+    return (uint32_t)EOF;
+  }
+  return static_cast<uint8_t>(*this->_cur++);
 }
 
-bool Lexer::eof() const { return this->_fd.eof(); }
+Token Lexer::make(TokenKind kind, const char *start, uint32_t payload) const {
+  return Token(kind, static_cast<uint32_t>(start - this->_start),
+               static_cast<uint32_t>(this->_cur - start), payload);
+}
 
 #define ADVANCE(TOKEN)                                                         \
-  this->tokens.push_back(Token(TokenKind::TOKEN));                             \
-  this->_fd.seekg(1, std::ios::cur)
+  ++this->_cur;                                                                \
+  return this->make(TokenKind::TOKEN, start)
 
-std::list<Token> Lexer::lex() {
-  this->tokens = std::list<Token>();
+Token Lexer::next() { return (this->*lex_token)(); }
 
-  std::streampos start = this->_fd.tellg();
+std::vector<Token> Lexer::lex() {
+  std::vector<Token> tokens;
+  do {
+    tokens.push_back(this->next());
+  } while (tokens.back().kind != TokenKind::Eof);
+  return tokens;
+}
 
-  while (!eof()) {
-    this->skip_trivia();
+template <typename Encoding> Token Lexer::lex_next() {
+  while (true) {
+    this->skip_trivia<Encoding>();
 
-    uint32_t ch = this->_fd.get();
+    const char *start = this->_cur;
+    uint32_t ch = this->get();
 
     switch (ch) {
     case '(': {
-      this->tokens.push_back(Token(TokenKind::LParen));
-      break;
+      return this->make(TokenKind::LParen, start);
     }
     case ')': {
-      this->tokens.push_back(Token(TokenKind::RParen));
-      break;
+      return this->make(TokenKind::RParen, start);
     }
     case '[': {
-      this->tokens.push_back(Token(TokenKind::LBrak));
-      break;
+      return this->make(TokenKind::LBrak, start);
     }
     case ']': {
-      this->tokens.push_back(Token(TokenKind::RBrak));
-      break;
+      return this->make(TokenKind::RBrak, start);
     }
     case '{': {
-      this->tokens.push_back(Token(TokenKind::LBrace));
-      break;
+      return this->make(TokenKind::LBrace, start);
     }
     case '}': {
-      this->tokens.push_back(Token(TokenKind::RBrace));
-      break;
+      return this->make(TokenKind::RBrace, start);
     }
     case '.': {
-      this->tokens.push_back(Token(TokenKind::Dot));
-      break;
+      return this->make(TokenKind::Dot, start);
     }
     case ',': {
-      this->tokens.push_back(Token(TokenKind::Comma));
-      break;
+      return this->make(TokenKind::Comma, start);
     }
     case ':': {
-      this->tokens.push_back(Token(TokenKind::Colon));
-      break;
+      if (this->peek() == ':') {
+        ADVANCE(ColonColon);
+      }
+      return this->make(TokenKind::Colon, start);
+    }
+    case '@': {
+      return this->make(TokenKind::At, start);
     }
     case ';': {
-      this->tokens.push_back(Token(TokenKind::Semicolon));
-      break;
+      return this->make(TokenKind::Semicolon, start);
     }
     case '^': {
-      this->tokens.push_back(Token(TokenKind::Caret));
-      break;
+      return this->make(TokenKind::Caret, start);
     }
     case '~': {
-      this->tokens.push_back(Token(TokenKind::Tilde));
-      break;
+      return this->make(TokenKind::Tilde, start);
     }
     case '+': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '+') {
         ADVANCE(PlusPlus);
-        break;
       } else if (next == '=') {
         ADVANCE(PlusEqual);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Plus));
-      break;
+      return this->make(TokenKind::Plus, start);
     }
     case '-': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '-') {
         ADVANCE(MinusMinus);
-        break;
       } else if (next == '=') {
         ADVANCE(MinusEqual);
-        break;
       } else if (next == '>') {
         ADVANCE(Arrow);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Minus));
-      break;
+      return this->make(TokenKind::Minus, start);
     }
     case '*': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(AsteriskEqual);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Asterisk));
-      break;
+      return this->make(TokenKind::Asterisk, start);
     }
     case '/': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(SlashEqual);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Slash));
-      break;
+      return this->make(TokenKind::Slash, start);
     }
     case '%': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(PercentEqual);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Percent));
-      break;
+      return this->make(TokenKind::Percent, start);
     }
     case '&': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(AmpEqual);
-        break;
       } else if (next == '&') {
         ADVANCE(AmpAmp);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Amp));
-      break;
+      return this->make(TokenKind::Amp, start);
     }
     case '|': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(PipeEqual);
-        break;
       } else if (next == '|') {
         ADVANCE(PipePipe);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Pipe));
-      break;
+      return this->make(TokenKind::Pipe, start);
     }
     case '=': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(EqualEqual);
-        break;
       } else if (next == '>') {
         ADVANCE(EqualBig);
-        break;
       }
 
-      this->tokens.push_back(Token(TokenKind::Equal));
-      break;
+      return this->make(TokenKind::Equal, start);
     }
     case '!': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(ExclamEqual);
-        break;
       }
-      this->tokens.push_back(Token(TokenKind::Exclam));
-      break;
+      return this->make(TokenKind::Exclam, start);
     }
     case '<': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(LesserEqual);
-        break;
       } else if (next == '<') {
-        this->_fd.seekg(1, std::ios::cur);
-        if (this->_fd.peek() == '=') {
+        if (this->peek(1) == '=') {
+          ++this->_cur;
           ADVANCE(LesserLesserEqual);
-          break;
         } else {
-          this->_fd.seekg(-1, std::ios::cur);
           ADVANCE(LesserLesser);
-          break;
         }
       }
-      this->tokens.push_back(Token(TokenKind::Lesser));
-      break;
+      return this->make(TokenKind::Lesser, start);
     }
     case '>': {
-      const uint32_t next = this->_fd.peek();
+      const uint32_t next = this->peek();
       if (next == '=') {
         ADVANCE(GreaterEqual);
-        break;
       } else if (next == '>') {
-        this->_fd.seekg(1, std::ios::cur);
-        if (this->_fd.peek() == '=') {
+        if (this->peek(1) == '=') {
+          ++this->_cur;
           ADVANCE(GreaterGreaterEqual);
-          break;
         } else {
-          this->_fd.seekg(-1, std::ios::cur);
           ADVANCE(GreaterGreater);
-          break;
         }
       }
-      this->tokens.push_back(Token(TokenKind::Greater));
-      break;
+      return this->make(TokenKind::Greater, start);
     }
     case (unsigned int)EOF:
-      this->tokens.push_back(Token(TokenKind::Eof));
-      goto finalize;
-      break;
+      return this->make(TokenKind::Eof, start);
     default: {
-      ch = StringUtil::utf8_from_file(this->_fd, ch);
+      ch = Encoding::decode(this->_cur, ch);
 
       if (LexerUtil::is_digit(ch)) {
-        std::string literal = lex_numeric(ch);
-        this->tokens.push_back(Token(TokenKind::Numeric, literal));
+        this->numerics.push_back(lex_numeric(ch));
+        return this->make(TokenKind::Numeric, start,
+                          static_cast<uint32_t>(this->numerics.size() - 1));
       } else if (ch == '\'' || ch == '`' || ch == '"') {
-        std::string literal = lex_string(ch);
-        this->tokens.push_back(Token(TokenKind::String, literal));
+        this->strings.values.push_back(lex_string(ch));
+        return this->make(
+            TokenKind::String, start,
+            static_cast<uint32_t>(this->strings.values.size() - 1));
       } else {
-        if (ch == '$' || ch == '_' || LexerUtil::is_unicode_char(ch)) {
-          std::stringstream idorkey;
-          idorkey << StringUtil::encode_utf8(ch);
-          while (!eof()) {
-            ch = this->_fd.get();
-            ch = StringUtil::utf8_from_file(this->_fd, ch);
-            if ((ch == '$' || ch == '_' || LexerUtil::is_unicode_char(ch) ||
-                 LexerUtil::is_unicode_digit(ch) ||
-                 LexerUtil::is_unicode_punc(ch))) {
-              idorkey << StringUtil::encode_utf8(ch);
-            } else {
-              this->_fd.seekg(-1, std::ios::cur);
+        if (LexerUtil::is_id_start(ch)) {
+          while (true) {
+            this->_cur = CharScan::find_ident_end(this->_cur, this->_end);
+            if (!Encoding::MultiByte || this->eof() || this->peek() < 0x80) {
+              break;
+            }
+            const char *prev = this->_cur;
+            ch = this->get();
+            ch = Encoding::decode(this->_cur, ch);
+            if (!LexerUtil::is_id_continue(ch)) {
+              this->_cur = prev;
               break;
             }
           }
-          const std::string idorkeystr = idorkey.str();
-          if (auto search = Lexer::Keywords.find(idorkeystr);
-              search != Lexer::Keywords.end()) {
-            this->tokens.push_back(Token(search->second));
+          const TokenKind kind =
+              Keywords::classify(start, this->_cur - start);
+          if (kind != TokenKind::Identifier) {
+            return this->make(kind, start);
           } else {
-            this->tokens.push_back(Token(TokenKind::Identifier, idorkeystr));
+            const Symbol symbol = this->interner.intern(
+                llvm::StringRef(start, this->_cur - start));
+            return this->make(TokenKind::Identifier, start, symbol.get_raw());
           }
         }
       }
     }
     }
   }
-finalize:
-  return this->tokens;
 }
 
 #undef ADVANCE
 
-void Lexer::skip_trivia() {
-  uint32_t current = 0;
+template <typename Encoding> void Lexer::skip_trivia() {
   while (!this->eof()) {
-    current = this->_fd.peek();
-    if (LexerUtil::is_whitespace(current)) {
-      this->_fd.seekg(1, std::ios::cur);
+    this->_cur = CharScan::skip_blank(this->_cur, this->_end);
+    const uint32_t current = this->peek();
+    if (current == '/' && this->peek(1) == '/') {
+      this->_cur = CharScan::find_line_end(this->_cur + 2, this->_end);
       continue;
-    } else if (current == '/') {
-      this->_fd.seekg(1, std::ios::cur);
-      current = this->_fd.peek();
-      if (current == '/') {
-        this->_fd.get();
-        while (!eof() && !LexerUtil::is_linefeed(this->_fd.get())) {
-        }
-        this->_fd.seekg(-1, std::ios::cur);
-        continue;
-      } else if (current == '*') {
-        while (!eof()) {
-          current = this->_fd.get();
-          if (current == '*' && this->_fd.get() == '/') {
-            this->_fd.seekg(1, std::ios::cur);
-            break;
-          }
-        }
-      }
-      this->_fd.seekg(-1, std::ios::cur);
+    } else if (current == '/' && this->peek(1) == '*') {
+      const char *close =
+          CharScan::find_block_comment_end(this->_cur + 2, this->_end);
+      this->_cur = std::min(close + 2, this->_end);
+      continue;
+    } else if (Encoding::MultiByte && current == 0xC2 &&
+               this->peek(1) == 0xA0) { // NBSP
+      this->_cur += 2;
+      continue;
+    } else if (Encoding::MultiByte && current == 0xE2 &&
+               this->peek(1) == 0x80 &&
+               (this->peek(2) == 0xA8 || this->peek(2) == 0xA9)) { // LS, PS
+      this->_cur += 3;
       continue;
     } else {
       break;
@@ -421,161 +646,210 @@ void Lexer::skip_trivia() {
   }
 }
 
-std::string Lexer::lex_numeric(uint32_t start) {
-  std::stringstream literal;
-  literal.put(start);
-
-  if (start == '0') {
-    if (this->_fd.peek() == 'x') {
-      literal.put(this->_fd.get()); // literal has '0x' until now
+// Decodes the literal while scanning it: integers are accumulated in 64 bits
+// and only re-read into an APInt if they overflow; decimals whose digits fit
+// in 64 bits go through NumberUtil, longer ones through APFloat.
+NumericValue Lexer::lex_numeric(uint32_t start) {
+  const char *begin = this->_cur - 1;
 
-      if (!eof() && LexerUtil::is_hex_digit(this->_fd.peek())) {
-        literal.put(this->_fd.get());
+  if (start == '0' && this->peek() == 'x') {
+    ++this->_cur; // literal has '0x' until now
 
-        while (!eof() && LexerUtil::is_hex_digit(this->_fd.peek())) {
-          literal.put(this->_fd.get());
-        }
-      } else {
-        this->errorCode = LexerErrorCode::InvalidHexNumericLiteral;
-        return literal.str();
-      }
+    const char *digits = this->_cur;
+    uint64_t value = 0;
+    bool overflow = false;
+    while (!eof() && LexerUtil::is_hex_digit(this->peek())) {
+      overflow |= (value >> 60) != 0;
+      value = value << 4 | llvm::hexDigitValue(*this->_cur++);
     }
+    if (this->_cur == digits) {
+      this->error(LexerErrorCode::InvalidHexNumericLiteral);
+      return {NumericValue::Integer, 0};
+    }
+    if (!overflow) {
+      return {NumericValue::Integer, value};
+    }
+    const llvm::StringRef text(digits, this->_cur - digits);
+    return this->make_wide_integer(llvm::APInt(4 * text.size(), text, 16));
   }
 
-  while (!eof() && LexerUtil::is_digit(this->_fd.peek())) {
-    literal.put(this->_fd.get());
-  }
+  uint64_t mantissa = start - '0';
+  bool exact = true;
+  auto accumulate = [&](uint32_t digit) {
+    if (mantissa > (UINT64_MAX - digit) / 10) {
+      exact = false;
+    } else {
+      mantissa = mantissa * 10 + digit;
+    }
+  };
 
-  if (this->_fd.peek() == '.') {
-    literal.put(this->_fd.get());
+  while (!eof() && LexerUtil::is_digit(this->peek())) {
+    accumulate(this->get() - '0');
+  }
 
-    while (!eof() && LexerUtil::is_digit(this->_fd.peek())) {
-      literal.put(this->_fd.get());
+  if (this->peek() != '.') {
+    if (exact) {
+      return {NumericValue::Integer, mantissa};
     }
+    const llvm::StringRef text(begin, this->_cur - begin);
+    return this->make_wide_integer(
+        llvm::APInt(llvm::APInt::getBitsNeeded(text, 10), text, 10));
+  }
+  ++this->_cur;
 
-    if (this->_fd.peek() == 'e' || this->_fd.peek() == 'E') {
-      literal.put(this->_fd.get());
-      if (this->_fd.peek() == '+' || this->_fd.peek() == '-') {
-        literal.put(this->_fd.get());
+  int64_t exponent = 0;
+  while (!eof() && LexerUtil::is_digit(this->peek())) {
+    accumulate(this->get() - '0');
+    --exponent;
+  }
 
-        if (!LexerUtil::is_digit(this->_fd.peek())) {
-          this->errorCode = LexerErrorCode::IncompleteExponentLiteral;
-        }
-      }
+  if (this->peek() == 'e' || this->peek() == 'E') {
+    ++this->_cur;
+    bool negative = false;
+    if (this->peek() == '+' || this->peek() == '-') {
+      negative = this->get() == '-';
 
-      while (!eof() && LexerUtil::is_digit(this->_fd.peek())) {
-        literal.put(this->_fd.get());
+      if (!LexerUtil::is_digit(this->peek())) {
+        this->error(LexerErrorCode::IncompleteExponentLiteral);
       }
     }
+
+    // Anything past the clamp is zero or infinity either way.
+    int64_t written = 0;
+    while (!eof() && LexerUtil::is_digit(this->peek())) {
+      written = std::min<int64_t>(written * 10 + (this->get() - '0'), 100000);
+    }
+    exponent += negative ? -written : written;
   }
 
-  return literal.str();
+  double value;
+  if (exact) {
+    value = NumberUtil::decimal_to_double(mantissa, exponent);
+  } else {
+    llvm::APFloat decoded(llvm::APFloat::IEEEdouble());
+    llvm::Expected<llvm::APFloat::opStatus> status = decoded.convertFromString(
+        llvm::StringRef(begin, this->_cur - begin),
+        llvm::APFloat::rmNearestTiesToEven);
+    if (!status) {
+      // Only an incomplete exponent gets here, and it was reported above.
+      llvm::consumeError(status.takeError());
+    }
+    value = decoded.convertToDouble();
+  }
+  return {NumericValue::Float, llvm::bit_cast<uint64_t>(value)};
 }
 
-std::string Lexer::lex_string(uint32_t start) {
-  std::stringstream literal;
-  uint32_t current = this->_fd.peek();
+NumericValue Lexer::make_wide_integer(llvm::APInt value) {
+  this->wide_integers.push_back(value.zextOrTrunc(value.getActiveBits()));
+  return {NumericValue::WideInteger,
+          static_cast<uint64_t>(this->wide_integers.size() - 1)};
+}
 
-  while ((current = this->_fd.get()) != start) {
-    if (eof() || LexerUtil::is_linefeed(current)) {
-      this->errorCode = LexerErrorCode::UnterminatedString;
-      break;
+// Literals without escapes, the common case, are a span of the buffer found
+// by one scan. The first backslash switches to decoding into `scratch`, which
+// is then copied into the arena.
+llvm::StringRef Lexer::lex_string(uint32_t start) {
+  const char quote = static_cast<char>(start);
+  const char *begin = this->_cur;
+  this->_cur = CharScan::find_string_end(this->_cur, this->_end, quote);
+  if (!this->eof() && *this->_cur == quote) {
+    return llvm::StringRef(begin, this->_cur++ - begin);
+  }
+
+  this->scratch.assign(begin, this->_cur);
+  while (!this->eof() && *this->_cur == '\\') {
+    ++this->_cur;
+    if (!this->lex_escape(start)) {
+      return this->strings.save(this->scratch);
     }
+    const char *run = this->_cur;
+    this->_cur = CharScan::find_string_end(this->_cur, this->_end, quote);
+    this->scratch.append(run, this->_cur);
+  }
 
-    // Handle Escape Sequences
-    if ('\\' == current) {
-      current = this->_fd.get();
-      switch (current) {
-      case '\\':
-        literal.put('\\');
-        break;
-      case '\'':
-        if ('\'' == start) {
-          literal.put(0x27); // '
-        } else {
-          literal.put(0x5C); // /
-          literal.put(0x27); // '
-        }
-        break;
-      case '"':
-        if ('"' == start) {
-          literal.put(0x22); // "
-        } else {
-          literal.put(0x5C); // /
-          literal.put(0x22); // "
-        }
-        break;
-      case 'n':
-        literal.put(0x0A);
-        break;
-      case 'r':
-        literal.put(0x0D);
-        break;
-      case 't':
-        literal.put(0x09);
-        break;
-      case 'b':
-        literal.put(0x08);
-        break;
-      case 'f':
-        literal.put(0x0C);
-        break;
-      case 'a':
-        literal.put(0x07);
-        break;
-      case 'v':
-        literal.put(0x0B);
-        break;
-      case '0':
-        literal.put(0x00);
-        break;
-      case 'x': {
-        std::stringstream value;
-        for (int i = 0; i < 2; ++i) {
-          current = this->_fd.get();
-          if (LexerUtil::is_hex_digit(current)) {
-            value.put(current);
-          } else {
-            this->errorCode = LexerErrorCode::UnterminatedHexByte;
-            return literal.str();
-          }
-        }
-        uint8_t v = static_cast<uint8_t>(std::stoi(value.str(), nullptr, 16));
-        literal << StringUtil::encode_utf8(v);
-        break;
+  if (!this->eof() && *this->_cur == quote) {
+    ++this->_cur;
+  } else {
+    // The line terminator belongs to the unterminated literal.
+    if (!this->eof()) {
+      ++this->_cur;
+    }
+    this->error(LexerErrorCode::UnterminatedString);
+  }
+  return this->strings.save(this->scratch);
+}
+
+// Decodes the escape after a backslash into `scratch`. Returns false after
+// reporting a malformed one.
+bool Lexer::lex_escape(uint32_t start) {
+  uint32_t current = this->get();
+  switch (current) {
+  case '\\':
+    this->scratch += '\\';
+    break;
+  case '\'':
+    if ('\'' != start) {
+      this->scratch += '\\';
+    }
+    this->scratch += '\'';
+    break;
+  case '"':
+    if ('"' != start) {
+      this->scratch += '\\';
+    }
+    this->scratch += '"';
+    break;
+  case 'n':
+    this->scratch += '\n';
+    break;
+  case 'r':
+    this->scratch += '\r';
+    break;
+  case 't':
+    this->scratch += '\t';
+    break;
+  case 'b':
+    this->scratch += '\b';
+    break;
+  case 'f':
+    this->scratch += '\f';
+    break;
+  case 'a':
+    this->scratch += '\a';
+    break;
+  case 'v':
+    this->scratch += '\v';
+    break;
+  case '0':
+    this->scratch += '\0';
+    break;
+  case 'x':
+  case 'u': {
+    const int digits = current == 'x' ? 2 : 4;
+    uint32_t value = 0;
+    for (int i = 0; i < digits; ++i) {
+      current = this->get();
+      if (!LexerUtil::is_hex_digit(current)) {
+        this->error(digits == 2
+                        ? LexerErrorCode::UnterminatedHexByte
+                        : LexerErrorCode::UnterminatedUnicodeCharacter);
+        return false;
       }
-      case 'u': {
-        std::stringstream value;
-        for (int i = 0; i < 4; ++i) {
-          current = this->_fd.get();
-          if (LexerUtil::is_hex_digit(current)) {
-            value.put(current);
-          } else {
-            this->errorCode = LexerErrorCode::UnterminatedUnicodeCharacter;
-            return literal.str();
-          }
-        }
-        uint32_t v =
-            static_cast<uint32_t>(std::stoul(value.str(), nullptr, 16));
-        literal << StringUtil::encode_utf8(v);
-        break;
+      value = value << 4 | llvm::hexDigitValue(static_cast<char>(current));
+    }
+    this->scratch += StringUtil::encode_utf8(value);
+    break;
+  }
+  default:
+    if (LexerUtil::is_whitespace(current)) {
+      while (LexerUtil::is_whitespace(this->peek())) {
+        ++this->_cur;
       }
-      default:
-        if (LexerUtil::is_whitespace(current)) {
-          skip_trivia();
-          if (!LexerUtil::is_linefeed(this->_fd.get())) {
-            this->errorCode = LexerErrorCode::UnterminatedString;
-            return literal.str();
-          }
-        }
+      if (!LexerUtil::is_linefeed(this->get())) {
+        this->error(LexerErrorCode::UnterminatedString);
+        return false;
       }
-      continue;
-    }
-
-    if (current != start) {
-      literal.put(current);
     }
   }
-
-  return literal.str();
+  return true;
 }
@@ -1,21 +1,27 @@
 #ifndef MR_MRC_LEXER_H
 #define MR_MRC_LEXER_H
 
+#include "Interner.h"
+#include "SourceManager.h"
+#include "llvm/ADT/APInt.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Allocator.h"
 #ifdef __cplusplus
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
-#include <iosfwd>
-#include <list>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <type_traits>
+#include <vector>
 
 namespace fs = std::filesystem;
 
-enum class TokenKind {
-  Eof = -1,
+enum class TokenKind : uint8_t {
+  Eof = 0,
   Plus = 1,
   Minus,
   Asterisk,
@@ -39,6 +45,8 @@ enum class TokenKind {
   Comma,
   Colon,
   Semicolon,
+  ColonColon,
+  At,
 
   PlusPlus,
   MinusMinus,
@@ -79,6 +87,9 @@ enum class TokenKind {
   Func,
 };
 
+inline constexpr size_t TokenKindCount =
+    static_cast<size_t>(TokenKind::Func) + 1;
+
 enum class LexerErrorCode {
   NoError = 0,
   InvalidHexNumericLiteral,
@@ -87,42 +98,137 @@ enum class LexerErrorCode {
   UnterminatedString,
   UnterminatedHexByte,
   UnterminatedUnicodeCharacter,
+
+  InvalidUtf8,
 };
 
+// A token is a span of the source buffer it was lexed from. Literals whose
+// value differs from their spelling keep it in a lexer side table, indexed by
+// `payload`.
 class Token {
 public:
-  Token(TokenKind kind);
-  Token(TokenKind kind, std::string literal);
+  static constexpr uint32_t NoPayload = UINT32_MAX;
 
-  std::string to_str() const;
-	llvm::StringRef to_strref() const;
-  const TokenKind kind;
-  const std::string literal;
+  Token() = default;
+  Token(TokenKind kind, uint32_t offset, uint32_t length,
+        uint32_t payload = NoPayload)
+      : kind(kind), offset(offset), length(length), payload(payload) {}
 
-private:
+  std::string to_str(llvm::StringRef source) const;
+  llvm::StringRef to_strref(llvm::StringRef source) const;
+
+  TokenKind kind = TokenKind::Eof;
+  uint32_t offset = 0;
+  uint32_t length = 0;
+  uint32_t payload = NoPayload;
 };
 
-class Lexer {
-public:
-  Lexer(std::ifstream file);
-  ~Lexer();
+static_assert(sizeof(Token) <= 16);
+static_assert(std::is_trivially_copyable_v<Token>);
+
+// The value of a Numeric token. Integers that do not fit in 64 bits are kept
+// in the lexer's wide integer table, which `bits` then indexes.
+struct NumericValue {
+  enum Kind : uint8_t { Integer, WideInteger, Float };
+
+  Kind kind;
+  uint64_t bits;
+
+  uint64_t get_integer() const { return this->bits; }
+  double get_float() const { return llvm::bit_cast<double>(this->bits); }
+};
 
-  std::list<Token> lex();
+// Decoded String values, indexed by the tokens' payload. Literals without
+// escapes are spans of the source buffer, which must outlive the table; the
+// others are decoded into `arena`.
+struct StringTable {
+  std::vector<llvm::StringRef> values;
+  llvm::BumpPtrAllocator arena;
 
-  static std::unique_ptr<Lexer> from_file(fs::path path);
+  // Copies `value` into the arena.
+  llvm::StringRef save(llvm::StringRef value);
+};
+
+// Replacement of the bytes [offset, offset + length) of a buffer by `text`.
+struct TextEdit {
+  uint32_t offset;
+  uint32_t length;
+  llvm::StringRef text;
+};
+
+class Lexer {
+public:
+  Lexer(llvm::StringRef buffer, Interner &interner);
+
+  // Lexes the next token. Once the input is exhausted every call returns
+  // an Eof token.
+  Token next();
+  // Lexes the rest of the input, up to and including the Eof token.
+  std::vector<Token> lex();
+  // Switches the lexer to `buffer`, which must be the buffer `tokens` were
+  // lexed from by this lexer with `edits` applied, and returns its tokens.
+  // Edits are sorted, non-overlapping and given in old buffer offsets. Only
+  // the tokens around each edit are lexed again; the rest are copied with
+  // their offsets shifted. Errors are only reported for re-lexed tokens.
+  // The lexer must still hold the values of `tokens`, so relex cannot
+  // follow take_strings(). Values are only kept for the returned tokens,
+  // whose payloads refer to them anew.
+  std::vector<Token> relex(llvm::StringRef buffer,
+                           llvm::ArrayRef<Token> tokens,
+                           llvm::ArrayRef<TextEdit> edits);
+
+  llvm::StringRef get_buffer() const;
+  Interner &get_interner() const;
+  // The decoded value of a String token.
+  llvm::StringRef get_string(const Token &token) const;
+  // Moves the decoded String values out of the lexer, which is left with
+  // an empty table.
+  StringTable take_strings();
+  // The decoded value of a Numeric token.
+  const NumericValue &get_numeric(const Token &token) const;
+  const llvm::APInt &get_wide_integer(const NumericValue &value) const;
+  // The interned name of an Identifier token.
+  Symbol get_symbol(const Token &token) const;
+
+  LexerErrorCode get_error() const;
+  // Byte offset of the input that caused the last error.
+  uint32_t get_error_offset() const;
+
+  static std::unique_ptr<Lexer> from_file(SourceManager &sm,
+                                          Interner &interner, fs::path path);
 
 private:
-  std::ifstream _fd;
-  std::streampos _fsize;
-  std::list<Token> tokens;
+  llvm::StringRef buffer;
+  const char *_start;
+  const char *_cur;
+  const char *_end;
+  Interner &interner;
+  Token (Lexer::*lex_token)();
+  StringTable strings;
+  // Decoding buffer for literals with escapes.
+  std::string scratch;
+  std::vector<NumericValue> numerics;
+  std::vector<llvm::APInt> wide_integers;
   LexerErrorCode errorCode = LexerErrorCode::NoError;
-
-  std::string lex_numeric(uint32_t start);
-  std::string lex_string(uint32_t start);
-  void skip_trivia();
+  uint32_t errorOffset = 0;
+
+  void load(llvm::StringRef buffer);
+  bool validate_edit(const char *begin, const char *end);
+  Token make(TokenKind kind, const char *start,
+             uint32_t payload = Token::NoPayload) const;
+  NumericValue lex_numeric(uint32_t start);
+  NumericValue make_wide_integer(llvm::APInt value);
+  llvm::StringRef lex_string(uint32_t start);
+  bool lex_escape(uint32_t start);
+  void error(LexerErrorCode code);
+
+  // Instantiated for AsciiEncoding and Utf8Encoding, see Lexer().
+  template <typename Encoding> Token lex_next();
+  template <typename Encoding> void skip_trivia();
   bool eof() const;
-
-  const static std::unordered_map<std::string, TokenKind> Keywords;
+  uint32_t peek() const;
+  uint32_t peek(uint32_t next) const;
+  uint32_t get();
 };
 
 #endif
@@ -1,14 +1,132 @@
-#include "AST.h"
-#include "Lexer.h"
-#include <llvm/Config/llvm-config.h>
-#include <memory>
-#include <stdio.h>
+#include "Driver.h"
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+namespace cl = llvm::cl;
+
+static cl::list<std::string> InputFiles(cl::Positional, cl::OneOrMore,
+                                        cl::desc("<input files>"));
+
+static cl::opt<std::string>
+    OutputFile("o", cl::value_desc("file"),
+               cl::desc("Write the output to <file> (single input only)"));
+
+static cl::opt<bool>
+    EmitLLVM("emit-llvm", cl::desc("Write LLVM IR text instead of an object "
+                                   "file"));
+
+static cl::opt<OptLevel> Optimization(
+    cl::desc("Optimization level:"), cl::init(OptLevel::O0),
+    cl::values(clEnumValN(OptLevel::O0, "O0", "No optimization (default)"),
+               clEnumValN(OptLevel::O1, "O1", "Optimize quickly"),
+               clEnumValN(OptLevel::O2, "O2", "Optimize"),
+               clEnumValN(OptLevel::O3, "O3", "Optimize aggressively"),
+               clEnumValN(OptLevel::Os, "Os", "Optimize for size")));
+
+enum class LTOMode { None, Thin };
+
+static cl::opt<LTOMode>
+    LTO("flto", cl::init(LTOMode::None),
+        cl::desc("Write bitcode for link-time optimization"),
+        cl::values(clEnumValN(LTOMode::Thin, "thin",
+                              "ThinLTO: import across modules and optimize "
+                              "them in parallel at link time")));
+
+static cl::opt<unsigned> CodegenPartitions(
+    "codegen-partitions", cl::init(1), cl::value_desc("N"),
+    cl::desc("Split each module into N partitions that are lowered to "
+             "machine code in parallel and combined into one object "
+             "(ELF targets only)"));
+
+static cl::opt<bool> SyntaxOnly("fsyntax-only",
+                                cl::desc("Stop after parsing the input"));
+
+static cl::opt<std::string> ModuleRoot(
+    "module-root", cl::init("."), cl::value_desc("directory"),
+    cl::desc("Find module a.b.c in <directory>/a/b/c.mr (default: .)"));
+
+static cl::opt<std::string> InterfaceDir(
+    "interface-dir", cl::init("."), cl::value_desc("directory"),
+    cl::desc("Write module interfaces to, and read them from, this "
+             "directory (default: .)"));
+
+static cl::opt<unsigned>
+    Jobs("j", cl::Prefix, cl::init(0), cl::value_desc("N"),
+         cl::desc("Compile N files in parallel (default: all cores)"));
+
+static cl::opt<std::string>
+    CacheDir("cache-dir", cl::value_desc("directory"),
+             cl::desc("Reuse parsed files from, and store them in, this "
+                      "directory"));
+
+static cl::opt<bool>
+    TimeReport("time-report",
+               cl::desc("Print the time spent in each compilation phase"));
+
+static cl::opt<std::string>
+    TimeTrace("time-trace", cl::value_desc("file"),
+              cl::desc("Write a Chrome trace of the compilation to <file>"));
+
+static cl::opt<unsigned> TimeTraceGranularity(
+    "time-trace-granularity", cl::init(500), cl::value_desc("us"),
+    cl::desc("Shortest event, in microseconds, kept in the time trace"));
 
 int main(int argc, char *argv[]) {
-  printf("Metareal compiler using LLVM version: %s\n", LLVM_VERSION_STRING);
+  llvm::InitLLVM init(argc, argv);
+  cl::SetVersionPrinter([](llvm::raw_ostream &os) {
+    os << "Metareal compiler using LLVM version: " << LLVM_VERSION_STRING
+       << "\n";
+  });
+  cl::ParseCommandLineOptions(argc, argv, "Metareal compiler\n");
+
+  if (!OutputFile.empty() && InputFiles.size() > 1) {
+    llvm::errs() << "Error: -o cannot be used with multiple input files\n";
+    return 1;
+  }
+  if (CodegenPartitions == 0) {
+    llvm::errs() << "Error: --codegen-partitions must be at least 1\n";
+    return 1;
+  }
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  DriverOptions options;
+  options.jobs = Jobs;
+  options.cache_dir = CacheDir.getValue();
+  options.time_report = TimeReport;
+  options.time_trace = !TimeTrace.empty();
+  options.time_trace_granularity = TimeTraceGranularity;
+  options.syntax_only = SyntaxOnly;
+  options.emit.kind = EmitLLVM ? OutputKind::LLVMAssembly : OutputKind::Object;
+  options.emit.opt_level = Optimization;
+  options.emit.thin_lto = LTO == LTOMode::Thin;
+  options.emit.codegen_partitions = CodegenPartitions;
+  options.output = OutputFile.getValue();
+  options.module_root = ModuleRoot.getValue();
+  options.interface_dir = InterfaceDir.getValue();
+
+  if (options.time_trace) {
+    llvm::timeTraceProfilerInitialize(TimeTraceGranularity, argv[0]);
+  }
+
+  std::vector<fs::path> inputs(InputFiles.begin(), InputFiles.end());
+  Driver driver(std::move(inputs), std::move(options));
+  const bool ok = driver.run(llvm::errs());
 
-  std::unique_ptr<Lexer> lexer = Lexer::from_file("hello.mr");
-	std::unique_ptr<Parser> parser = std::make_unique<Parser>(Parser(lexer->lex()));
-	parser->parse();
-  return 0;
+  if (llvm::timeTraceProfilerEnabled()) {
+    if (llvm::Error error = llvm::timeTraceProfilerWrite(TimeTrace, "-")) {
+      llvm::errs() << "Error writing \"" << TimeTrace
+                   << "\": " << llvm::toString(std::move(error)) << "\n";
+    }
+    llvm::timeTraceProfilerCleanup();
+  }
+  return ok ? 0 : 1;
 }
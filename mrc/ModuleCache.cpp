@@ -0,0 +1,380 @@
+#include "ModuleCache.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifndef MRC_VERSION_STRING
+#define MRC_VERSION_STRING "unknown"
+#endif
+
+#ifndef MRC_UNICODE_VERSION
+#define MRC_UNICODE_VERSION "unknown"
+#endif
+
+namespace {
+
+constexpr char Magic[8] = {'M', 'R', 'C', 'A', 'S', 'T', '\0', '\0'};
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+// A span of the blob: names and strings.
+struct BlobRef {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t byte_order;
+  uint64_t compiler;
+  uint64_t content_size;
+  uint64_t content_hash;
+  // Of everything after the header, to reject torn or corrupted entries.
+  uint64_t payload_hash;
+
+  uint32_t root;
+  uint32_t node_count;
+  uint32_t extra_count;
+  uint32_t name_count;
+  uint32_t string_count;
+  uint32_t blob_size;
+  uint32_t wide_count;
+  uint32_t word_count;
+
+  // File offsets of the sections, each 8-byte aligned.
+  uint64_t kinds;
+  uint64_t ops;
+  uint64_t offsets;
+  uint64_t data;
+  uint64_t extra;
+  uint64_t names;
+  uint64_t strings;
+  uint64_t blob;
+  uint64_t wides;
+  uint64_t words;
+};
+
+// Covers the Unicode version of the identifier tables and FormatVersion
+// too.
+uint64_t get_compiler_hash() {
+  static const uint64_t hash = llvm::xxh3_64bits(llvm::StringRef(
+      "mrc " MRC_VERSION_STRING " llvm " LLVM_VERSION_STRING
+      " unicode " MRC_UNICODE_VERSION " format " +
+      std::to_string(ModuleCache::FormatVersion)));
+  return hash;
+}
+
+uint64_t align(uint64_t offset) { return (offset + 7) & ~uint64_t(7); }
+
+// Appends `size` bytes at the next aligned offset and returns that offset.
+uint64_t append(std::string &out, const void *data, size_t size) {
+  out.resize(align(out.size()), '\0');
+  const uint64_t offset = out.size();
+  out.append(static_cast<const char *>(data), size);
+  return offset;
+}
+
+// Whether `count` elements of `size` bytes at `offset` lie inside the entry.
+bool in_bounds(uint64_t offset, uint64_t count, uint64_t size,
+               uint64_t file_size) {
+  return offset % 8 == 0 && offset <= file_size &&
+         count <= (file_size - offset) / size;
+}
+
+bool has_symbol(NodeKind kind) {
+  return kind == NodeKind::Identifier || kind == NodeKind::Let ||
+         kind == NodeKind::Path || kind == NodeKind::Alias;
+}
+
+// Paths keep a second Symbol, the exported name, in rhs.
+bool has_second_symbol(NodeKind kind) { return kind == NodeKind::Path; }
+
+} // namespace
+
+ModuleCache::ModuleCache(fs::path directory) : directory(std::move(directory)) {
+  llvm::sys::fs::create_directories(this->directory.string());
+}
+
+// Compilers of other versions, LLVM versions or entry formats get names of
+// their own, so that they can share a directory without evicting each
+// other's entries.
+fs::path ModuleCache::get_entry_path(llvm::StringRef content) const {
+  const llvm::XXH128_hash_t hash = llvm::xxh3_128bits(
+      llvm::ArrayRef<uint8_t>(content.bytes_begin(), content.size()));
+  char name[64];
+  snprintf(name, sizeof(name), "%016llx%016llx-%016llx.mrast",
+           static_cast<unsigned long long>(hash.high64),
+           static_cast<unsigned long long>(hash.low64),
+           static_cast<unsigned long long>(get_compiler_hash()));
+  return this->directory / name;
+}
+
+bool ModuleCache::load(llvm::StringRef content, Interner &interner,
+                       Entry &entry, Ast &ast, NodeId &root,
+                       StringTable &strings) const {
+  llvm::Expected<llvm::sys::fs::file_t> file =
+      llvm::sys::fs::openNativeFileForRead(
+          this->get_entry_path(content).string());
+  if (!file) {
+    llvm::consumeError(file.takeError());
+    return false;
+  }
+  Header header;
+  llvm::sys::fs::file_status status;
+  std::error_code error = llvm::sys::fs::status(*file, status);
+  Entry mapping;
+  if (!error && status.getSize() >= sizeof(header)) {
+    // Private, so that later passes can rewrite nodes in place.
+    mapping = Entry(*file, Entry::priv, status.getSize(), 0, error);
+  }
+  llvm::sys::fs::closeFile(*file);
+  if (error || !mapping) {
+    return false;
+  }
+  char *base = mapping.data();
+  const uint64_t size = mapping.size();
+
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.format != FormatVersion || header.byte_order != ByteOrderMark ||
+      header.compiler != get_compiler_hash() ||
+      header.content_size != content.size() ||
+      header.content_hash != llvm::xxh3_64bits(content) ||
+      header.payload_hash !=
+          llvm::xxh3_64bits(llvm::StringRef(base, size).drop_front(
+              sizeof(header)))) {
+    return false;
+  }
+
+  const uint32_t nodes = header.node_count;
+  if (!in_bounds(header.kinds, nodes, sizeof(NodeKind), size) ||
+      !in_bounds(header.ops, nodes, sizeof(Operation), size) ||
+      !in_bounds(header.offsets, nodes, sizeof(uint32_t), size) ||
+      !in_bounds(header.data, nodes, sizeof(Ast::Data), size) ||
+      !in_bounds(header.extra, header.extra_count, sizeof(NodeId), size) ||
+      !in_bounds(header.names, header.name_count, sizeof(BlobRef), size) ||
+      !in_bounds(header.strings, header.string_count, sizeof(BlobRef), size) ||
+      !in_bounds(header.blob, header.blob_size, 1, size) ||
+      !in_bounds(header.wides, header.wide_count, sizeof(Ast::WideInteger),
+                 size) ||
+      !in_bounds(header.words, header.word_count, sizeof(uint64_t), size) ||
+      (nodes != 0 && header.root >= nodes)) {
+    return false;
+  }
+
+  // The entry is trusted no further than its bounds: every reference must
+  // point inside its table, and children must precede their parents.
+  const NodeKind *kinds =
+      reinterpret_cast<const NodeKind *>(base + header.kinds);
+  const Ast::Data *data =
+      reinterpret_cast<const Ast::Data *>(base + header.data);
+  const NodeId *extra = reinterpret_cast<const NodeId *>(base + header.extra);
+  const BlobRef *names =
+      reinterpret_cast<const BlobRef *>(base + header.names);
+  const BlobRef *string_refs =
+      reinterpret_cast<const BlobRef *>(base + header.strings);
+  const Ast::WideInteger *wides =
+      reinterpret_cast<const Ast::WideInteger *>(base + header.wides);
+  auto valid_ref = [&header](const BlobRef &ref) {
+    return ref.offset <= header.blob_size &&
+           ref.length <= header.blob_size - ref.offset;
+  };
+  for (uint32_t i = 0; i < header.name_count; ++i) {
+    if (!valid_ref(names[i])) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.string_count; ++i) {
+    if (!valid_ref(string_refs[i])) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < header.wide_count; ++i) {
+    const uint64_t word_count = (uint64_t(wides[i].bit_width) + 63) / 64;
+    if (wides[i].bit_width == 0 || wides[i].word > header.word_count ||
+        word_count > header.word_count - wides[i].word) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < nodes; ++i) {
+    bool valid = true;
+    switch (kinds[i]) {
+    case NodeKind::IntegerLiteral:
+    case NodeKind::FloatLiteral:
+    case NodeKind::BoolLiteral:
+      break;
+    case NodeKind::WideIntegerLiteral:
+      valid = data[i].lhs < header.wide_count;
+      break;
+    case NodeKind::StringLiteral:
+      valid = data[i].lhs < header.string_count;
+      break;
+    case NodeKind::Identifier:
+      valid = data[i].lhs < header.name_count;
+      break;
+    case NodeKind::Unary:
+      valid = data[i].lhs < i;
+      break;
+    case NodeKind::Binary:
+      valid = data[i].lhs < i && data[i].rhs < i;
+      break;
+    case NodeKind::List:
+    case NodeKind::Block:
+      valid = data[i].lhs <= header.extra_count &&
+              data[i].rhs <= header.extra_count - data[i].lhs;
+      for (uint32_t j = 0; valid && j < data[i].rhs; ++j) {
+        valid = extra[data[i].lhs + j].get_raw() < i;
+      }
+      break;
+    case NodeKind::Let:
+      valid = data[i].lhs < header.name_count && data[i].rhs < i;
+      break;
+    case NodeKind::Path:
+      valid = data[i].lhs < header.name_count &&
+              data[i].rhs < header.name_count;
+      break;
+    case NodeKind::Alias:
+      valid = data[i].lhs < header.name_count && data[i].rhs < i;
+      break;
+    default:
+      valid = false;
+      break;
+    }
+    if (!valid) {
+      return false;
+    }
+  }
+
+  // The nodes keep the entry's name indices; Ast resolves them through
+  // `names`.
+  const char *blob = base + header.blob;
+  ast.clear();
+  ast.names.reserve(header.name_count);
+  for (uint32_t i = 0; i < header.name_count; ++i) {
+    ast.names.push_back(interner.intern(
+        llvm::StringRef(blob + names[i].offset, names[i].length)));
+  }
+  ast.kinds.view(reinterpret_cast<NodeKind *>(base + header.kinds), nodes);
+  ast.ops.view(reinterpret_cast<Operation *>(base + header.ops), nodes);
+  ast.offsets.view(reinterpret_cast<uint32_t *>(base + header.offsets),
+                   nodes);
+  ast.data.view(reinterpret_cast<Ast::Data *>(base + header.data), nodes);
+  ast.extra.view(reinterpret_cast<NodeId *>(base + header.extra),
+                 header.extra_count);
+  ast.wide_integers.view(
+      reinterpret_cast<Ast::WideInteger *>(base + header.wides),
+      header.wide_count);
+  ast.words.view(reinterpret_cast<uint64_t *>(base + header.words),
+                 header.word_count);
+
+  strings.values.clear();
+  strings.values.reserve(header.string_count);
+  for (uint32_t i = 0; i < header.string_count; ++i) {
+    strings.values.emplace_back(blob + string_refs[i].offset,
+                                string_refs[i].length);
+  }
+  root = nodes != 0 ? NodeId(header.root) : NodeId();
+  entry = std::move(mapping);
+  return true;
+}
+
+void ModuleCache::store(llvm::StringRef content, const Interner &interner,
+                        const Ast &ast, NodeId root,
+                        llvm::ArrayRef<llvm::StringRef> strings) const {
+  // Symbols are replaced by indices into the entry's own name table.
+  std::vector<Ast::Data> data(ast.data.data(),
+                              ast.data.data() + ast.data.size());
+  llvm::DenseMap<uint32_t, uint32_t> local_names;
+  std::vector<BlobRef> names;
+  std::string blob;
+  auto localize = [&](uint32_t &symbol) {
+    auto inserted = local_names.try_emplace(
+        symbol, static_cast<uint32_t>(names.size()));
+    if (inserted.second) {
+      const llvm::StringRef spelling =
+          interner.get_spelling(ast.get_name(symbol));
+      names.push_back({static_cast<uint32_t>(blob.size()),
+                       static_cast<uint32_t>(spelling.size())});
+      blob.append(spelling.data(), spelling.size());
+    }
+    symbol = inserted.first->second;
+  };
+  for (uint32_t i = 0; i < ast.size(); ++i) {
+    if (has_symbol(ast.kinds[i])) {
+      localize(data[i].lhs);
+    }
+    if (has_second_symbol(ast.kinds[i])) {
+      localize(data[i].rhs);
+    }
+  }
+  std::vector<BlobRef> string_refs;
+  for (llvm::StringRef string : strings) {
+    string_refs.push_back({static_cast<uint32_t>(blob.size()),
+                           static_cast<uint32_t>(string.size())});
+    blob.append(string.data(), string.size());
+  }
+
+  Header header = {};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.format = FormatVersion;
+  header.byte_order = ByteOrderMark;
+  header.compiler = get_compiler_hash();
+  header.content_size = content.size();
+  header.content_hash = llvm::xxh3_64bits(content);
+  header.root = root.is_valid() ? root.get_raw() : 0;
+  header.node_count = ast.size();
+  header.extra_count = static_cast<uint32_t>(ast.extra.size());
+  header.name_count = static_cast<uint32_t>(names.size());
+  header.string_count = static_cast<uint32_t>(string_refs.size());
+  header.blob_size = static_cast<uint32_t>(blob.size());
+  header.wide_count = ast.wide_integers.size();
+  header.word_count = ast.words.size();
+
+  std::string out(sizeof(header), '\0');
+  header.kinds = append(out, ast.kinds.data(), ast.kinds.size());
+  header.ops = append(out, ast.ops.data(), ast.ops.size());
+  header.offsets =
+      append(out, ast.offsets.data(), ast.offsets.size() * sizeof(uint32_t));
+  header.data = append(out, data.data(), data.size() * sizeof(Ast::Data));
+  header.extra =
+      append(out, ast.extra.data(), ast.extra.size() * sizeof(NodeId));
+  header.names = append(out, names.data(), names.size() * sizeof(BlobRef));
+  header.strings =
+      append(out, string_refs.data(), string_refs.size() * sizeof(BlobRef));
+  header.blob = append(out, blob.data(), blob.size());
+  header.wides =
+      append(out, ast.wide_integers.data(),
+             ast.wide_integers.size() * sizeof(Ast::WideInteger));
+  header.words =
+      append(out, ast.words.data(), ast.words.size() * sizeof(uint64_t));
+  header.payload_hash =
+      llvm::xxh3_64bits(llvm::StringRef(out).drop_front(sizeof(header)));
+  std::memcpy(&out[0], &header, sizeof(header));
+
+  const fs::path path = this->get_entry_path(content);
+  int fd;
+  llvm::SmallString<128> temp;
+  if (llvm::sys::fs::createUniqueFile(
+          (this->directory / "%%%%%%%%%%%%.tmp").string(), fd, temp)) {
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << out;
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temp);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(temp, path.string())) {
+    llvm::sys::fs::remove(temp);
+  }
+}
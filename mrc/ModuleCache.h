@@ -0,0 +1,47 @@
+#ifndef MR_MRC_MODULECACHE_H
+#define MR_MRC_MODULECACHE_H
+
+#include "AST.h"
+#include "Interner.h"
+#include "SourceManager.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <string>
+#include <vector>
+
+// Parsed files cached on disk, keyed by a hash of their content and of the
+// compiler version. An entry is a header followed by the AST arrays and the
+// name and string tables, all addressed by file offsets rather than
+// pointers. A hit maps the entry privately and the loaded Ast and strings
+// view it in place: nodes keep the entry's name indices, and only the
+// names themselves are interned. Entries are written to a temporary file
+// and renamed into place, so concurrent compilers only ever see complete
+// entries.
+class ModuleCache {
+public:
+  static constexpr uint32_t FormatVersion = 5;
+
+  // The mapping of a loaded entry, which must outlive its Ast and strings.
+  using Entry = llvm::sys::fs::mapped_file_region;
+
+  explicit ModuleCache(fs::path directory);
+
+  // Returns false on a miss or an unusable entry. Names are interned into
+  // `interner`, since Symbols are only meaningful within one process.
+  bool load(llvm::StringRef content, Interner &interner, Entry &entry,
+            Ast &ast, NodeId &root, StringTable &strings) const;
+  // Failures are ignored: a missing entry only costs a reparse.
+  void store(llvm::StringRef content, const Interner &interner,
+             const Ast &ast, NodeId root,
+             llvm::ArrayRef<llvm::StringRef> strings) const;
+
+private:
+  fs::path directory;
+
+  fs::path get_entry_path(llvm::StringRef content) const;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "ModuleInterface.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <cstring>
+
+#ifndef MRC_VERSION_STRING
+#define MRC_VERSION_STRING "unknown"
+#endif
+
+#ifndef MRC_UNICODE_VERSION
+#define MRC_UNICODE_VERSION "unknown"
+#endif
+
+namespace {
+
+constexpr char Magic[8] = {'M', 'R', 'C', 'I', 'F', 'C', '\0', '\0'};
+constexpr uint32_t ByteOrderMark = 0x01020304;
+
+// A span of the name blob.
+struct BlobRef {
+  uint32_t offset;
+  uint32_t length;
+};
+
+struct Header {
+  char magic[8];
+  uint32_t format;
+  uint32_t byte_order;
+  uint64_t compiler;
+  // Of everything after the header, to reject torn or corrupted files.
+  uint64_t payload_hash;
+
+  uint64_t source_hash;
+  BlobRef name;
+  uint32_t depth;
+  uint32_t import_count;
+  uint32_t export_count;
+  uint32_t blob_size;
+};
+
+// The header is followed by the import entries, the export entries and the
+// blob, in that order.
+struct ImportEntry {
+  uint64_t hash;
+  BlobRef module;
+};
+
+struct ExportEntry {
+  BlobRef name;
+  uint32_t width;
+  uint8_t kind;
+  uint8_t padding[3];
+};
+
+static_assert(sizeof(Header) % 8 == 0);
+static_assert(sizeof(ImportEntry) % 8 == 0);
+static_assert(sizeof(ExportEntry) % 8 == 0);
+
+uint64_t get_compiler_hash() {
+  static const uint64_t hash = llvm::xxh3_64bits(llvm::StringRef(
+      "mrc " MRC_VERSION_STRING " llvm " LLVM_VERSION_STRING
+      " unicode " MRC_UNICODE_VERSION " interface " +
+      std::to_string(ModuleInterface::FormatVersion)));
+  return hash;
+}
+
+BlobRef add_name(std::string &blob, llvm::StringRef name) {
+  const BlobRef ref = {static_cast<uint32_t>(blob.size()),
+                       static_cast<uint32_t>(name.size())};
+  blob.append(name.data(), name.size());
+  return ref;
+}
+
+template <typename T> void append(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+} // namespace
+
+ModuleInterface::ModuleInterface(std::string name, uint64_t source_hash,
+                                 uint32_t depth, std::vector<Import> imports,
+                                 std::vector<Export> exports)
+    : name(std::move(name)), source_hash(source_hash), depth(depth),
+      imports(std::move(imports)), exports(std::move(exports)) {
+  // Only what dependents compile against goes into the hash, so editing a
+  // module without changing its exports leaves them current.
+  std::string key;
+  append(key, this->depth);
+  for (uint32_t i = 0; i < this->exports.size(); ++i) {
+    const Export &symbol = this->exports[i];
+    this->index.try_emplace(symbol.name, i);
+    append(key, symbol.type.kind);
+    append(key, symbol.type.width);
+    append(key, static_cast<uint32_t>(symbol.name.size()));
+    key += symbol.name;
+  }
+  this->hash = llvm::xxh3_64bits(key);
+}
+
+llvm::StringRef ModuleInterface::get_name() const { return this->name; }
+
+uint64_t ModuleInterface::get_source_hash() const {
+  return this->source_hash;
+}
+
+uint32_t ModuleInterface::get_depth() const { return this->depth; }
+
+llvm::ArrayRef<ModuleInterface::Import> ModuleInterface::get_imports() const {
+  return this->imports;
+}
+
+llvm::ArrayRef<ModuleInterface::Export> ModuleInterface::get_exports() const {
+  return this->exports;
+}
+
+const ModuleInterface::Export *
+ModuleInterface::find(llvm::StringRef name) const {
+  auto found = this->index.find(name);
+  return found != this->index.end() ? &this->exports[found->second]
+                                    : nullptr;
+}
+
+uint64_t ModuleInterface::get_hash() const { return this->hash; }
+
+std::string ModuleInterface::serialize() const {
+  Header header = {};
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.format = FormatVersion;
+  header.byte_order = ByteOrderMark;
+  header.compiler = get_compiler_hash();
+  header.source_hash = this->source_hash;
+  header.depth = this->depth;
+  header.import_count = static_cast<uint32_t>(this->imports.size());
+  header.export_count = static_cast<uint32_t>(this->exports.size());
+
+  std::string blob;
+  header.name = add_name(blob, this->name);
+  std::string out(sizeof(header), '\0');
+  for (const Import &import : this->imports) {
+    append(out, ImportEntry{import.hash, add_name(blob, import.module)});
+  }
+  for (const Export &symbol : this->exports) {
+    ExportEntry entry = {};
+    entry.name = add_name(blob, symbol.name);
+    entry.width = symbol.type.width;
+    entry.kind = symbol.type.kind;
+    append(out, entry);
+  }
+  header.blob_size = static_cast<uint32_t>(blob.size());
+  out += blob;
+  header.payload_hash =
+      llvm::xxh3_64bits(llvm::StringRef(out).drop_front(sizeof(header)));
+  std::memcpy(&out[0], &header, sizeof(header));
+  return out;
+}
+
+std::unique_ptr<ModuleInterface>
+ModuleInterface::read(const fs::path &path) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file =
+      llvm::MemoryBuffer::getFile(path.string(), /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!file) {
+    return nullptr;
+  }
+  const llvm::StringRef contents = (*file)->getBuffer();
+  if (contents.size() < sizeof(Header)) {
+    return nullptr;
+  }
+  Header header;
+  std::memcpy(&header, contents.data(), sizeof(header));
+  if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+      header.format != FormatVersion || header.byte_order != ByteOrderMark ||
+      header.compiler != get_compiler_hash()) {
+    return nullptr;
+  }
+  const uint64_t size = sizeof(Header) +
+                        uint64_t(header.import_count) * sizeof(ImportEntry) +
+                        uint64_t(header.export_count) * sizeof(ExportEntry) +
+                        header.blob_size;
+  if (contents.size() != size ||
+      llvm::xxh3_64bits(contents.drop_front(sizeof(header))) !=
+          header.payload_hash) {
+    return nullptr;
+  }
+
+  const char *entries = contents.data() + sizeof(Header);
+  const llvm::StringRef blob = contents.take_back(header.blob_size);
+  bool valid = true;
+  auto get_name = [&blob, &valid](BlobRef ref) {
+    if (ref.offset > blob.size() || ref.length > blob.size() - ref.offset) {
+      valid = false;
+      return std::string();
+    }
+    return blob.substr(ref.offset, ref.length).str();
+  };
+
+  std::vector<Import> imports;
+  imports.reserve(header.import_count);
+  for (uint32_t i = 0; i < header.import_count; ++i) {
+    ImportEntry entry;
+    std::memcpy(&entry, entries, sizeof(entry));
+    entries += sizeof(entry);
+    imports.push_back({get_name(entry.module), entry.hash});
+  }
+  std::vector<Export> exports;
+  exports.reserve(header.export_count);
+  for (uint32_t i = 0; i < header.export_count; ++i) {
+    ExportEntry entry;
+    std::memcpy(&entry, entries, sizeof(entry));
+    entries += sizeof(entry);
+    if (entry.kind > ValueType::String) {
+      return nullptr;
+    }
+    exports.push_back(
+        {get_name(entry.name),
+         {static_cast<ValueType::Kind>(entry.kind), entry.width}});
+  }
+  std::string name = get_name(header.name);
+  if (!valid) {
+    return nullptr;
+  }
+  return std::make_unique<ModuleInterface>(std::move(name), header.source_hash,
+                                           header.depth, std::move(imports),
+                                           std::move(exports));
+}
+
+bool ModuleInterface::write(const fs::path &path) const {
+  const std::string out = this->serialize();
+  llvm::SmallString<128> model(path.parent_path().string());
+  if (!model.empty() && llvm::sys::fs::create_directories(model)) {
+    return false;
+  }
+  llvm::sys::path::append(model, "%%%%%%%%%%%%.tmp");
+  int fd;
+  llvm::SmallString<128> temp;
+  if (llvm::sys::fs::createUniqueFile(model, fd, temp)) {
+    return false;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, /*shouldClose=*/true);
+    os << out;
+    os.close();
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temp);
+      return false;
+    }
+  }
+  if (llvm::sys::fs::rename(temp, path.string())) {
+    llvm::sys::fs::remove(temp);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,81 @@
+#ifndef MR_MRC_MODULEINTERFACE_H
+#define MR_MRC_MODULEINTERFACE_H
+
+#include "SourceManager.h"
+#include "ValueType.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What dependents need to know about a compiled module: the types of its
+// exports, every top-level `let`, and enough to tell whether it is still
+// current. Written after the module compiles, so that later compilations of
+// its dependents read this file instead of parsing the module's source.
+//
+// The file is a header, the import and export tables and a blob of names,
+// addressed by offsets. It is written to a temporary file and renamed into
+// place like ModuleCache entries.
+class ModuleInterface {
+public:
+  static constexpr uint32_t FormatVersion = 1;
+
+  struct Import {
+    std::string module;
+    // get_hash() of the import's interface this module was compiled
+    // against.
+    uint64_t hash;
+  };
+
+  struct Export {
+    std::string name;
+    ValueType type;
+  };
+
+  // `depth` is the length of the longest import chain below the module: 0
+  // for a module without imports.
+  ModuleInterface(std::string name, uint64_t source_hash, uint32_t depth,
+                  std::vector<Import> imports, std::vector<Export> exports);
+
+  // Returns nullptr if the file is missing or unusable.
+  static std::unique_ptr<ModuleInterface> read(const fs::path &path);
+  // Returns false if the file could not be written.
+  bool write(const fs::path &path) const;
+
+  llvm::StringRef get_name() const;
+  uint64_t get_source_hash() const;
+  uint32_t get_depth() const;
+  llvm::ArrayRef<Import> get_imports() const;
+  llvm::ArrayRef<Export> get_exports() const;
+  // Returns nullptr if the module exports no such name.
+  const Export *find(llvm::StringRef name) const;
+  // Hash of what dependents compile against: the depth, which orders their
+  // constructors, and the name and type of every export. Not of the source,
+  // the imports or the rest of the file, so that a module can be edited
+  // without changing these and its dependents stay current. Dependents
+  // record it for each import and are rebuilt when it changes.
+  uint64_t get_hash() const;
+
+private:
+  std::string name;
+  uint64_t source_hash;
+  uint32_t depth;
+  std::vector<Import> imports;
+  std::vector<Export> exports;
+  llvm::StringMap<uint32_t> index;
+  uint64_t hash;
+
+  std::string serialize() const;
+};
+
+// The interfaces of the modules an Ast imports, keyed by the Symbol of the
+// module name in its Path nodes.
+using InterfaceMap = llvm::DenseMap<uint32_t, const ModuleInterface *>;
+
+#endif
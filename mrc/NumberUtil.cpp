@@ -0,0 +1,118 @@
+#include "NumberUtil.h"
+
+#include "llvm/ADT/bit.h"
+
+#include "Pow5Table.inc"
+
+namespace {
+
+constexpr int MantissaBits = 52;
+constexpr int ExponentBias = 1023;
+constexpr int InfiniteExponent = 0x7FF;
+
+// Powers of ten that are exact in a double, for the fast path.
+constexpr double ExactPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+
+struct Product {
+  uint64_t high;
+  uint64_t low;
+};
+
+Product multiply(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+  const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  return {static_cast<uint64_t>(product >> 64), static_cast<uint64_t>(product)};
+#else
+  const uint64_t a_lo = a & 0xFFFFFFFF, a_hi = a >> 32;
+  const uint64_t b_lo = b & 0xFFFFFFFF, b_hi = b >> 32;
+  const uint64_t lo_lo = a_lo * b_lo;
+  const uint64_t hi_lo = a_hi * b_lo;
+  const uint64_t lo_hi = a_lo * b_hi;
+  const uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+  return {a_hi * b_hi + (hi_lo >> 32) + (cross >> 32),
+          (cross << 32) | (lo_lo & 0xFFFFFFFF)};
+#endif
+}
+
+// floor(log2(10^q)) + 63, valid for q in [-1233, 1233].
+int64_t binary_exponent(int64_t q) { return (((152170 + 65536) * q) >> 16) + 63; }
+
+double make_double(uint64_t mantissa, int64_t exponent) {
+  return llvm::bit_cast<double>(mantissa |
+                                static_cast<uint64_t>(exponent)
+                                    << MantissaBits);
+}
+
+} // namespace
+
+// Eisel-Lemire: multiply the normalized mantissa by a 128-bit approximation
+// of 5^exponent and round the top 54 bits. With the full mantissa at hand
+// the truncated product is always precise enough (Mushtak and Lemire, "Fast
+// number parsing without fallback", 2023).
+double NumberUtil::decimal_to_double(uint64_t mantissa, int64_t exponent) {
+  if (mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+    const double value = static_cast<double>(mantissa);
+    return exponent < 0 ? value / ExactPowers[-exponent]
+                        : value * ExactPowers[exponent];
+  }
+  if (mantissa == 0 || exponent < Pow5MinExponent) {
+    return 0.0;
+  }
+  if (exponent > Pow5MaxExponent) {
+    return make_double(0, InfiniteExponent);
+  }
+
+  const int leading_zeros = llvm::countl_zero(mantissa);
+  mantissa <<= leading_zeros;
+  const uint64_t *power = Pow5Table[exponent - Pow5MinExponent];
+  Product product = multiply(mantissa, power[0]);
+  // Only the top 55 bits matter; look at the low half of the power when the
+  // bits below them might carry into them.
+  constexpr uint64_t PrecisionMask = ~uint64_t(0) >> 55;
+  if ((product.high & PrecisionMask) == PrecisionMask) {
+    const Product low = multiply(mantissa, power[1]);
+    product.low += low.high;
+    if (low.high > product.low) {
+      ++product.high;
+    }
+  }
+
+  const int upper_bit = static_cast<int>(product.high >> 63);
+  const int shift = upper_bit + 64 - MantissaBits - 3;
+  uint64_t bits = product.high >> shift;
+  int64_t binary = binary_exponent(exponent) + upper_bit - leading_zeros +
+                   ExponentBias;
+
+  if (binary <= 0) {
+    // Subnormal, or zero once shifted out entirely.
+    if (-binary + 1 >= 64) {
+      return 0.0;
+    }
+    bits >>= -binary + 1;
+    bits += bits & 1;
+    bits >>= 1;
+    return make_double(bits & ~(uint64_t(1) << MantissaBits),
+                       bits < (uint64_t(1) << MantissaBits) ? 0 : 1);
+  }
+
+  // A product that lands exactly halfway must round to even; only small
+  // exponents can produce one.
+  if (product.low <= 1 && exponent >= -4 && exponent <= 23 &&
+      (bits & 3) == 1 && (bits << shift) == product.high) {
+    bits &= ~uint64_t(1);
+  }
+  bits += bits & 1;
+  bits >>= 1;
+  if (bits >= (uint64_t(2) << MantissaBits)) {
+    bits = uint64_t(1) << MantissaBits;
+    ++binary;
+  }
+  bits &= ~(uint64_t(1) << MantissaBits);
+  if (binary >= InfiniteExponent) {
+    return make_double(0, InfiniteExponent);
+  }
+  return make_double(bits, binary);
+}
@@ -0,0 +1,13 @@
+#ifndef MR_MRC_NUMBERUTIL_H
+#define MR_MRC_NUMBERUTIL_H
+
+#include <cstdint>
+
+class NumberUtil {
+public:
+  // The double nearest to mantissa * 10^exponent, ties to even. `mantissa`
+  // must hold every significant digit of the literal.
+  static double decimal_to_double(uint64_t mantissa, int64_t exponent);
+};
+
+#endif
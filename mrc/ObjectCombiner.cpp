@@ -0,0 +1,378 @@
+#include "ObjectCombiner.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Object/ELF.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool report(llvm::raw_ostream &errs, const llvm::Twine &message) {
+  errs << "Error combining partitions: " << message << "\n";
+  return false;
+}
+
+bool report(llvm::raw_ostream &errs, llvm::Error error) {
+  return report(errs, llvm::toString(std::move(error)));
+}
+
+// Pads `out` to `alignment` and appends `size` bytes at the offset returned.
+uint64_t append(std::string &out, const void *data, size_t size,
+                uint64_t alignment) {
+  out.resize(llvm::alignTo(out.size(), std::max<uint64_t>(alignment, 1)),
+             '\0');
+  const uint64_t offset = out.size();
+  out.append(static_cast<const char *>(data), size);
+  return offset;
+}
+
+template <typename Relocation, typename Resolve>
+uint64_t append_relocations(std::string &out,
+                            llvm::ArrayRef<Relocation> relocations,
+                            uint64_t alignment, bool mips64el,
+                            Resolve resolve) {
+  std::vector<Relocation> copies(relocations.begin(), relocations.end());
+  for (Relocation &relocation : copies) {
+    relocation.setSymbolAndType(resolve(relocation.getSymbol(mips64el)),
+                                relocation.getType(mips64el), mips64el);
+  }
+  return append(out, copies.data(), copies.size() * sizeof(Relocation),
+                alignment);
+}
+
+// Orders visibilities from the least to the most restrictive.
+unsigned visibility_rank(unsigned visibility) {
+  switch (visibility) {
+  case llvm::ELF::STV_PROTECTED:
+    return 1;
+  case llvm::ELF::STV_HIDDEN:
+    return 2;
+  case llvm::ELF::STV_INTERNAL:
+    return 3;
+  }
+  return 0;
+}
+
+// Symbol and string tables are rebuilt for the output. Address-significance
+// tables list symbol indices and are dropped, which only makes identical
+// code folding in the final link more conservative.
+bool is_rebuilt(uint32_t type) {
+  return type == llvm::ELF::SHT_SYMTAB || type == llvm::ELF::SHT_STRTAB ||
+         type == llvm::ELF::SHT_LLVM_ADDRSIG;
+}
+
+} // namespace
+
+bool ObjectCombiner::combine(llvm::ArrayRef<llvm::StringRef> objects,
+                             llvm::raw_ostream &os, llvm::raw_ostream &errs) {
+  if (objects.empty()) {
+    return report(errs, "no objects");
+  }
+  const auto [elf_class, encoding] =
+      llvm::object::getElfArchType(objects.front());
+  if (elf_class == llvm::ELF::ELFCLASS32) {
+    return encoding == llvm::ELF::ELFDATA2LSB
+               ? combine_elf<llvm::object::ELF32LE>(objects, os, errs)
+               : combine_elf<llvm::object::ELF32BE>(objects, os, errs);
+  }
+  if (elf_class == llvm::ELF::ELFCLASS64) {
+    return encoding == llvm::ELF::ELFDATA2LSB
+               ? combine_elf<llvm::object::ELF64LE>(objects, os, errs)
+               : combine_elf<llvm::object::ELF64BE>(objects, os, errs);
+  }
+  return report(errs, "only ELF objects can be combined");
+}
+
+template <typename ELFT>
+bool ObjectCombiner::combine_elf(llvm::ArrayRef<llvm::StringRef> objects,
+                                 llvm::raw_ostream &os,
+                                 llvm::raw_ostream &errs) {
+  using Ehdr = typename ELFT::Ehdr;
+  using Shdr = typename ELFT::Shdr;
+  using Sym = typename ELFT::Sym;
+  using Rel = typename ELFT::Rel;
+  using Rela = typename ELFT::Rela;
+
+  std::vector<llvm::object::ELFFile<ELFT>> files;
+  for (llvm::StringRef object : objects) {
+    llvm::Expected<llvm::object::ELFFile<ELFT>> file =
+        llvm::object::ELFFile<ELFT>::create(object);
+    if (!file) {
+      return report(errs, file.takeError());
+    }
+    const Ehdr &header = file->getHeader();
+    if (!header.checkMagic() || header.e_type != llvm::ELF::ET_REL) {
+      return report(errs, "not a relocatable ELF object");
+    }
+    if (!files.empty() &&
+        (header.e_ident[llvm::ELF::EI_CLASS] !=
+             files.front().getHeader().e_ident[llvm::ELF::EI_CLASS] ||
+         header.e_ident[llvm::ELF::EI_DATA] !=
+             files.front().getHeader().e_ident[llvm::ELF::EI_DATA] ||
+         header.e_machine != files.front().getHeader().e_machine ||
+         header.e_flags != files.front().getHeader().e_flags)) {
+      return report(errs, "objects are for different machines");
+    }
+    files.push_back(std::move(*file));
+  }
+
+  // One string table holds the names of both sections and symbols.
+  std::string strings(1, '\0');
+  auto add_string = [&strings](llvm::StringRef string) -> uint32_t {
+    if (string.empty()) {
+      return 0;
+    }
+    const uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings += string;
+    strings += '\0';
+    return offset;
+  };
+
+  struct Section {
+    size_t file;
+    const Shdr *header;
+    uint32_t name;
+    llvm::ArrayRef<uint8_t> contents;
+  };
+  std::vector<Section> sections;
+  // The output index of every input section, or 0 if it is not copied.
+  std::vector<std::vector<uint32_t>> section_indices(files.size());
+  std::vector<const Shdr *> symbol_tables(files.size(), nullptr);
+  for (size_t i = 0; i < files.size(); ++i) {
+    auto headers = files[i].sections();
+    if (!headers) {
+      return report(errs, headers.takeError());
+    }
+    llvm::Expected<llvm::StringRef> names =
+        files[i].getSectionStringTable(*headers);
+    if (!names) {
+      return report(errs, names.takeError());
+    }
+    section_indices[i].assign(headers->size(), 0);
+    for (const Shdr &header : headers->drop_front()) {
+      const uint32_t type = header.sh_type;
+      if (type == llvm::ELF::SHT_GROUP ||
+          type == llvm::ELF::SHT_SYMTAB_SHNDX) {
+        return report(errs, "section groups and extended section indices "
+                            "are not supported");
+      }
+      if (type == llvm::ELF::SHT_SYMTAB) {
+        symbol_tables[i] = &header;
+      }
+      if (is_rebuilt(type) ||
+          ((type == llvm::ELF::SHT_REL || type == llvm::ELF::SHT_RELA) &&
+           header.sh_info < headers->size() &&
+           is_rebuilt((*headers)[header.sh_info].sh_type))) {
+        continue;
+      }
+      llvm::Expected<llvm::StringRef> name =
+          files[i].getSectionName(header, *names);
+      if (!name) {
+        return report(errs, name.takeError());
+      }
+      llvm::ArrayRef<uint8_t> contents;
+      if (type != llvm::ELF::SHT_NOBITS) {
+        llvm::Expected<llvm::ArrayRef<uint8_t>> data =
+            files[i].getSectionContents(header);
+        if (!data) {
+          return report(errs, data.takeError());
+        }
+        contents = *data;
+      }
+      sections.push_back({i, &header, add_string(*name), contents});
+      section_indices[i][&header - headers->begin()] =
+          static_cast<uint32_t>(sections.size());
+    }
+  }
+
+  // Section 0 is the null section and the copies follow it.
+  const uint32_t symtab_index = static_cast<uint32_t>(sections.size()) + 1;
+  const uint32_t strtab_index = symtab_index + 1;
+  if (strtab_index >= llvm::ELF::SHN_LORESERVE) {
+    return report(errs, "too many sections");
+  }
+  const uint32_t symtab_name = add_string(".symtab");
+  const uint32_t strtab_name = add_string(".strtab");
+
+  // Locals are copied as they are. A global is entered once, under its
+  // definition if an input has one, with the most restrictive visibility
+  // any input gives it.
+  std::vector<Sym> locals(1);
+  std::vector<Sym> globals;
+  llvm::StringMap<uint32_t> global_indices;
+  struct SymbolIndex {
+    bool global;
+    uint32_t index;
+  };
+  std::vector<std::vector<SymbolIndex>> symbol_indices(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (symbol_tables[i] == nullptr) {
+      continue;
+    }
+    auto symbols = files[i].symbols(symbol_tables[i]);
+    if (!symbols) {
+      return report(errs, symbols.takeError());
+    }
+    llvm::Expected<llvm::StringRef> names =
+        files[i].getStringTableForSymtab(*symbol_tables[i]);
+    if (!names) {
+      return report(errs, names.takeError());
+    }
+    symbol_indices[i].assign(symbols->size(), {false, 0});
+    for (size_t j = 1; j < symbols->size(); ++j) {
+      const Sym &symbol = (*symbols)[j];
+      llvm::Expected<llvm::StringRef> name = symbol.getName(*names);
+      if (!name) {
+        return report(errs, name.takeError());
+      }
+      Sym copy = symbol;
+      if (symbol.st_shndx != llvm::ELF::SHN_UNDEF &&
+          symbol.st_shndx < llvm::ELF::SHN_LORESERVE) {
+        if (symbol.st_shndx >= section_indices[i].size()) {
+          return report(errs, "symbol \"" + *name +
+                                  "\" is defined in a missing section");
+        }
+        copy.st_shndx = section_indices[i][symbol.st_shndx];
+      }
+
+      if (symbol.getBinding() == llvm::ELF::STB_LOCAL) {
+        copy.st_name = add_string(*name);
+        symbol_indices[i][j] = {false, static_cast<uint32_t>(locals.size())};
+        locals.push_back(copy);
+        continue;
+      }
+      const auto [entry, inserted] = global_indices.try_emplace(
+          *name, static_cast<uint32_t>(globals.size()));
+      symbol_indices[i][j] = {true, entry->second};
+      if (inserted) {
+        copy.st_name = add_string(*name);
+        globals.push_back(copy);
+        continue;
+      }
+      Sym &global = globals[entry->second];
+      const unsigned char visibility =
+          visibility_rank(copy.getVisibility()) >
+                  visibility_rank(global.getVisibility())
+              ? copy.getVisibility()
+              : global.getVisibility();
+      const bool weak = copy.getBinding() == llvm::ELF::STB_WEAK;
+      const bool global_weak = global.getBinding() == llvm::ELF::STB_WEAK;
+      if (copy.st_shndx != llvm::ELF::SHN_UNDEF) {
+        if (global.st_shndx != llvm::ELF::SHN_UNDEF && !global_weak &&
+            !weak) {
+          return report(errs, "duplicate symbol \"" + *name + "\"");
+        }
+        if (global.st_shndx == llvm::ELF::SHN_UNDEF || (global_weak && !weak)) {
+          copy.st_name = global.st_name;
+          global = copy;
+        }
+      } else if (global.st_shndx == llvm::ELF::SHN_UNDEF && global_weak &&
+                 !weak) {
+        global.setBinding(copy.getBinding());
+      }
+      global.setVisibility(visibility);
+    }
+  }
+
+  const uint32_t first_global = static_cast<uint32_t>(locals.size());
+  bool unknown_symbol = false;
+  std::string out(sizeof(Ehdr), '\0');
+  std::vector<Shdr> headers(1);
+  for (const Section &section : sections) {
+    const llvm::object::ELFFile<ELFT> &file = files[section.file];
+    const std::vector<uint32_t> &indices = section_indices[section.file];
+    const std::vector<SymbolIndex> &symbols = symbol_indices[section.file];
+    auto resolve = [&](uint32_t symbol) -> uint32_t {
+      if (symbol == 0) {
+        return 0;
+      }
+      if (symbol >= symbols.size()) {
+        unknown_symbol = true;
+        return 0;
+      }
+      return symbols[symbol].global ? first_global + symbols[symbol].index
+                                    : symbols[symbol].index;
+    };
+    auto map_section = [&indices](uint32_t index) -> uint32_t {
+      return index < indices.size() ? indices[index] : 0;
+    };
+
+    Shdr header = *section.header;
+    header.sh_name = section.name;
+    if (header.sh_type == llvm::ELF::SHT_REL) {
+      auto relocations = file.rels(*section.header);
+      if (!relocations) {
+        return report(errs, relocations.takeError());
+      }
+      header.sh_offset = append_relocations<Rel>(
+          out, *relocations, header.sh_addralign, file.isMips64EL(), resolve);
+    } else if (header.sh_type == llvm::ELF::SHT_RELA) {
+      auto relocations = file.relas(*section.header);
+      if (!relocations) {
+        return report(errs, relocations.takeError());
+      }
+      header.sh_offset = append_relocations<Rela>(
+          out, *relocations, header.sh_addralign, file.isMips64EL(), resolve);
+    } else if (header.sh_type == llvm::ELF::SHT_NOBITS) {
+      header.sh_offset = out.size();
+    } else {
+      header.sh_offset = append(out, section.contents.data(),
+                                section.contents.size(), header.sh_addralign);
+    }
+    if (header.sh_type == llvm::ELF::SHT_REL ||
+        header.sh_type == llvm::ELF::SHT_RELA) {
+      header.sh_link = symtab_index;
+      header.sh_info = map_section(header.sh_info);
+    } else if (header.sh_flags & llvm::ELF::SHF_LINK_ORDER) {
+      header.sh_link = map_section(header.sh_link);
+    }
+    headers.push_back(header);
+  }
+  if (unknown_symbol) {
+    return report(errs, "relocation against a symbol out of range");
+  }
+
+  std::vector<Sym> symbols = std::move(locals);
+  symbols.insert(symbols.end(), globals.begin(), globals.end());
+  const uint64_t word = ELFT::Is64Bits ? 8 : 4;
+  Shdr symtab{};
+  symtab.sh_name = symtab_name;
+  symtab.sh_type = llvm::ELF::SHT_SYMTAB;
+  symtab.sh_link = strtab_index;
+  symtab.sh_info = first_global;
+  symtab.sh_entsize = sizeof(Sym);
+  symtab.sh_addralign = word;
+  symtab.sh_size = symbols.size() * sizeof(Sym);
+  symtab.sh_offset =
+      append(out, symbols.data(), symbols.size() * sizeof(Sym), word);
+  headers.push_back(symtab);
+  Shdr strtab{};
+  strtab.sh_name = strtab_name;
+  strtab.sh_type = llvm::ELF::SHT_STRTAB;
+  strtab.sh_addralign = 1;
+  strtab.sh_size = strings.size();
+  strtab.sh_offset = append(out, strings.data(), strings.size(), 1);
+  headers.push_back(strtab);
+
+  Ehdr header = files.front().getHeader();
+  header.e_entry = 0;
+  header.e_phoff = 0;
+  header.e_phentsize = 0;
+  header.e_phnum = 0;
+  header.e_ehsize = sizeof(Ehdr);
+  header.e_shoff =
+      append(out, headers.data(), headers.size() * sizeof(Shdr), word);
+  header.e_shentsize = sizeof(Shdr);
+  header.e_shnum = static_cast<uint16_t>(headers.size());
+  header.e_shstrndx = static_cast<uint16_t>(strtab_index);
+  std::memcpy(out.data(), &header, sizeof(Ehdr));
+  os << out;
+  return true;
+}
@@ -0,0 +1,27 @@
+#ifndef MR_MRC_OBJECTCOMBINER_H
+#define MR_MRC_OBJECTCOMBINER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Combines relocatable ELF objects into one in process, like `ld -r` does
+// for the objects the code generator writes. Every input section is kept
+// as a section of its own, the symbol tables are merged so that a global
+// defined in one input resolves the references of the others, and
+// relocations are renumbered to match. The output depends only on the
+// inputs and their order.
+class ObjectCombiner {
+public:
+  // Failures, including inputs that are not relocatable ELF objects of the
+  // same machine, are reported to `errs`.
+  static bool combine(llvm::ArrayRef<llvm::StringRef> objects,
+                      llvm::raw_ostream &os, llvm::raw_ostream &errs);
+
+private:
+  template <typename ELFT>
+  static bool combine_elf(llvm::ArrayRef<llvm::StringRef> objects,
+                          llvm::raw_ostream &os, llvm::raw_ostream &errs);
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "ObjectEmitter.h"
+
+#include "ObjectCombiner.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Bitcode/BitcodeWriterPass.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/TargetParser/Triple.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+llvm::OptimizationLevel get_pipeline_level(OptLevel level) {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::OptimizationLevel::O0;
+  case OptLevel::O1:
+    return llvm::OptimizationLevel::O1;
+  case OptLevel::O2:
+    return llvm::OptimizationLevel::O2;
+  case OptLevel::O3:
+    return llvm::OptimizationLevel::O3;
+  case OptLevel::Os:
+    return llvm::OptimizationLevel::Os;
+  }
+  return llvm::OptimizationLevel::O0;
+}
+
+llvm::CodeGenOptLevel get_codegen_level(OptLevel level) {
+  switch (level) {
+  case OptLevel::O0:
+    return llvm::CodeGenOptLevel::None;
+  case OptLevel::O1:
+    return llvm::CodeGenOptLevel::Less;
+  case OptLevel::O2:
+  case OptLevel::Os:
+    return llvm::CodeGenOptLevel::Default;
+  case OptLevel::O3:
+    return llvm::CodeGenOptLevel::Aggressive;
+  }
+  return llvm::CodeGenOptLevel::Default;
+}
+
+} // namespace
+
+bool ObjectEmitter::emit(llvm::Module &module, const fs::path &output,
+                         const EmitOptions &options,
+                         llvm::ThreadPoolInterface *pool,
+                         llvm::raw_ostream &errs) {
+  const std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string error;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple, error);
+  if (target == nullptr) {
+    errs << "Error creating target \"" << triple << "\": " << error << "\n";
+    return false;
+  }
+
+  std::unique_ptr<llvm::TargetMachine> machine =
+      create_machine(*target, triple, options.opt_level);
+  module.setTargetTriple(triple);
+  module.setDataLayout(machine->createDataLayout());
+
+  if (options.codegen_partitions > 1 && options.kind == OutputKind::Object &&
+      !options.thin_lto && !llvm::Triple(triple).isOSBinFormatELF()) {
+    errs << "Error: partitioned objects can only be combined for ELF "
+            "targets\n";
+    return false;
+  }
+
+  std::error_code code;
+  llvm::ToolOutputFile file(output.string(), code,
+                            options.kind == OutputKind::LLVMAssembly
+                                ? llvm::sys::fs::OF_Text
+                                : llvm::sys::fs::OF_None);
+  if (code) {
+    errs << "Error opening \"" << output.string() << "\": " << code.message()
+         << "\n";
+    return false;
+  }
+
+  const bool bitcode = options.thin_lto && options.kind == OutputKind::Object;
+  optimize(module, *machine, options, bitcode ? &file.os() : nullptr);
+
+  if (options.kind == OutputKind::LLVMAssembly) {
+    module.print(file.os(), nullptr);
+  } else if (bitcode) {
+    // Written by the pipeline.
+  } else if (options.codegen_partitions > 1) {
+    if (!lower_partitioned(module, *target, triple, options, file.os(), pool,
+                           errs)) {
+      return false;
+    }
+  } else if (!lower(module, *machine, file.os())) {
+    errs << "Error writing \"" << output.string()
+         << "\": the target cannot emit object files\n";
+    return false;
+  }
+
+  file.os().flush();
+  if (file.os().has_error()) {
+    errs << "Error writing \"" << output.string()
+         << "\": " << file.os().error().message() << "\n";
+    file.os().clear_error();
+    return false;
+  }
+  file.keep();
+  return true;
+}
+
+// A TargetMachine is not safe to share between threads, so each module
+// gets its own.
+std::unique_ptr<llvm::TargetMachine>
+ObjectEmitter::create_machine(const llvm::Target &target,
+                              const std::string &triple, OptLevel level) {
+  return std::unique_ptr<llvm::TargetMachine>(target.createTargetMachine(
+      triple, "generic", "", llvm::TargetOptions(), llvm::Reloc::PIC_,
+      std::nullopt, get_codegen_level(level)));
+}
+
+void ObjectEmitter::optimize(llvm::Module &module,
+                             llvm::TargetMachine &machine,
+                             const EmitOptions &options,
+                             llvm::raw_ostream *bitcode) {
+  // The pipelines read these from each function, so that modules imported
+  // at link time keep the level they were compiled with.
+  for (llvm::Function &function : module) {
+    if (function.isDeclaration()) {
+      continue;
+    }
+    if (options.opt_level == OptLevel::O0) {
+      function.addFnAttr(llvm::Attribute::OptimizeNone);
+      function.addFnAttr(llvm::Attribute::NoInline);
+    } else if (options.opt_level == OptLevel::Os) {
+      function.addFnAttr(llvm::Attribute::OptimizeForSize);
+    }
+  }
+
+  llvm::LoopAnalysisManager loops;
+  llvm::FunctionAnalysisManager functions;
+  llvm::CGSCCAnalysisManager sccs;
+  llvm::ModuleAnalysisManager modules;
+  llvm::PassBuilder builder(&machine);
+  builder.registerModuleAnalyses(modules);
+  builder.registerCGSCCAnalyses(sccs);
+  builder.registerFunctionAnalyses(functions);
+  builder.registerLoopAnalyses(loops);
+  builder.crossRegisterProxies(loops, functions, sccs, modules);
+
+  const llvm::OptimizationLevel level = get_pipeline_level(options.opt_level);
+  llvm::ModulePassManager passes;
+  if (options.opt_level == OptLevel::O0) {
+    passes = builder.buildO0DefaultPipeline(
+        level, options.thin_lto ? llvm::ThinOrFullLTOPhase::ThinLTOPreLink
+                                : llvm::ThinOrFullLTOPhase::None);
+  } else if (options.thin_lto) {
+    passes = builder.buildThinLTOPreLinkDefaultPipeline(level);
+  } else {
+    passes = builder.buildPerModuleDefaultPipeline(level);
+  }
+  if (bitcode != nullptr) {
+    // The module hash lets the linker cache the backend compile of
+    // modules that did not change.
+    passes.addPass(llvm::BitcodeWriterPass(
+        *bitcode, /*ShouldPreserveUseListOrder=*/false,
+        /*EmitSummaryIndex=*/true, /*EmitModuleHash=*/true));
+  }
+  passes.run(module, modules);
+}
+
+// Returns false if the target cannot emit object files.
+bool ObjectEmitter::lower(llvm::Module &module, llvm::TargetMachine &machine,
+                          llvm::raw_pwrite_stream &os) {
+  llvm::legacy::PassManager passes;
+  if (machine.addPassesToEmitFile(passes, os, nullptr,
+                                  llvm::CodeGenFileType::ObjectFile)) {
+    return false;
+  }
+  passes.run(module);
+  return true;
+}
+
+// Functions are assigned to partitions by a hash of their name, so the
+// split, and with it the output, is the same on every run. LLVMContext is
+// single-threaded: partitions travel to their tasks as bitcode and are read
+// back into a context of their own there.
+bool ObjectEmitter::lower_partitioned(llvm::Module &module,
+                                      const llvm::Target &target,
+                                      const std::string &triple,
+                                      const EmitOptions &options,
+                                      llvm::raw_pwrite_stream &os,
+                                      llvm::ThreadPoolInterface *pool,
+                                      llvm::raw_ostream &errs) {
+  // SplitModule turns every local into a hidden global so that partitions
+  // can refer to each other's. Suffix them with a hash of the module so
+  // that they cannot collide with those of other modules in the final link.
+  llvm::SmallString<0> contents;
+  llvm::raw_svector_ostream stream(contents);
+  llvm::WriteBitcodeToFile(module, stream);
+  llvm::MD5 md5;
+  md5.update(contents.str());
+  llvm::MD5::MD5Result hash;
+  md5.final(hash);
+  const std::string suffix = "." + hash.digest().substr(0, 16).str();
+  for (llvm::GlobalValue &value : module.global_values()) {
+    if (value.hasLocalLinkage()) {
+      value.setName((value.hasName() ? value.getName() : "mrc.local") +
+                    suffix);
+    }
+  }
+
+  std::vector<llvm::SmallString<0>> partitions;
+  llvm::SplitModule(module, options.codegen_partitions,
+                    [&partitions](std::unique_ptr<llvm::Module> partition) {
+                      partitions.emplace_back();
+                      llvm::raw_svector_ostream os(partitions.back());
+                      llvm::WriteBitcodeToFile(*partition, os);
+                    });
+
+  std::vector<llvm::SmallString<0>> objects(partitions.size());
+  std::vector<std::string> errors(partitions.size());
+  auto lower_partition = [&](size_t i) {
+    llvm::LLVMContext context;
+    llvm::Expected<std::unique_ptr<llvm::Module>> partition =
+        llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(partitions[i].str(), "partition"), context);
+    if (!partition) {
+      errors[i] = llvm::toString(partition.takeError());
+      return;
+    }
+    std::unique_ptr<llvm::TargetMachine> machine =
+        create_machine(target, triple, options.opt_level);
+    llvm::raw_svector_ostream object(objects[i]);
+    if (!lower(**partition, *machine, object)) {
+      errors[i] = "the target cannot emit object files";
+    }
+  };
+  if (pool == nullptr) {
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      lower_partition(i);
+    }
+  } else {
+    // Shares the driver's threads: waiting from one of them runs the
+    // group's tasks instead of blocking it.
+    llvm::ThreadPoolTaskGroup group(*pool);
+    for (size_t i = 0; i < partitions.size(); ++i) {
+      group.async([&lower_partition, i] { lower_partition(i); });
+    }
+    group.wait();
+  }
+  for (const std::string &error : errors) {
+    if (!error.empty()) {
+      errs << "Error lowering partition: " << error << "\n";
+      return false;
+    }
+  }
+
+  std::vector<llvm::StringRef> buffers(objects.begin(), objects.end());
+  return ObjectCombiner::combine(buffers, os, errs);
+}
@@ -0,0 +1,75 @@
+#ifndef MR_MRC_OBJECTEMITTER_H
+#define MR_MRC_OBJECTEMITTER_H
+
+#include "llvm/IR/Module.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace fs = std::filesystem;
+
+enum class OutputKind {
+  Object,
+  // Textual IR, for inspecting what the code generator produced.
+  LLVMAssembly,
+};
+
+enum class OptLevel {
+  O0,
+  O1,
+  O2,
+  O3,
+  // O2 without transformations that grow code.
+  Os,
+};
+
+struct EmitOptions {
+  OutputKind kind = OutputKind::Object;
+  OptLevel opt_level = OptLevel::O0;
+  // Run the ThinLTO pre-link pipeline and write bitcode with a module
+  // summary instead of machine code, so that the linker can import
+  // functions across modules and optimize them in parallel.
+  bool thin_lto = false;
+  // Split optimized modules into this many partitions by function, lower
+  // them to machine code in parallel and combine them into the one output
+  // object. Only used for object output, and only on ELF targets.
+  unsigned codegen_partitions = 1;
+};
+
+// Optimizes and writes modules for the host target. The module is lowered
+// in memory and streamed straight into a buffered output file, which is
+// removed again if writing fails.
+class ObjectEmitter {
+public:
+  // Sets the module's triple and data layout for the host, runs the default
+  // pipeline of the new pass manager for `options.opt_level` and writes the
+  // result to `output`. Partitions are lowered on `pool`, or one after the
+  // other without one. Failures are reported to `errs`.
+  static bool emit(llvm::Module &module, const fs::path &output,
+                   const EmitOptions &options,
+                   llvm::ThreadPoolInterface *pool, llvm::raw_ostream &errs);
+
+private:
+  static std::unique_ptr<llvm::TargetMachine>
+  create_machine(const llvm::Target &target, const std::string &triple,
+                 OptLevel level);
+  // Writes the optimized module with its summary to `bitcode` if given.
+  static void optimize(llvm::Module &module, llvm::TargetMachine &machine,
+                       const EmitOptions &options, llvm::raw_ostream *bitcode);
+  static bool lower(llvm::Module &module, llvm::TargetMachine &machine,
+                    llvm::raw_pwrite_stream &os);
+  static bool lower_partitioned(llvm::Module &module,
+                                const llvm::Target &target,
+                                const std::string &triple,
+                                const EmitOptions &options,
+                                llvm::raw_pwrite_stream &os,
+                                llvm::ThreadPoolInterface *pool,
+                                llvm::raw_ostream &errs);
+};
+
+#endif
@@ -1,30 +1,411 @@
 #include "Parser.h"
 
-Parser::Parser(std::list<Token> tokens) {
-  this->tokens = std::vector(tokens.begin(), tokens.end());
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <string>
+#include <utility>
+
+namespace {
+
+enum class Associativity : uint8_t { Left, Right };
+
+struct BinaryOperator {
+  // Zero for tokens that are not binary operators.
+  uint8_t precedence = 0;
+  Associativity associativity = Associativity::Left;
+  Operation op = Operation::Add;
+};
+
+// Binds tighter than every binary operator.
+constexpr uint8_t UnaryPrecedence = 12;
+
+constexpr std::array<BinaryOperator, TokenKindCount> build_binary_operators() {
+  std::array<BinaryOperator, TokenKindCount> table = {};
+  auto set = [&table](TokenKind kind, uint8_t precedence,
+                      Associativity associativity, Operation op) {
+    table[static_cast<size_t>(kind)] = {precedence, associativity, op};
+  };
+  constexpr Associativity L = Associativity::Left;
+  constexpr Associativity R = Associativity::Right;
+
+  set(TokenKind::Equal, 1, R, Operation::Assign);
+  set(TokenKind::PlusEqual, 1, R, Operation::AddAssign);
+  set(TokenKind::MinusEqual, 1, R, Operation::SubAssign);
+  set(TokenKind::AsteriskEqual, 1, R, Operation::MulAssign);
+  set(TokenKind::SlashEqual, 1, R, Operation::DivAssign);
+  set(TokenKind::PercentEqual, 1, R, Operation::RemAssign);
+  set(TokenKind::AmpEqual, 1, R, Operation::BitAndAssign);
+  set(TokenKind::PipeEqual, 1, R, Operation::BitOrAssign);
+  set(TokenKind::LesserLesserEqual, 1, R, Operation::ShlAssign);
+  set(TokenKind::GreaterGreaterEqual, 1, R, Operation::ShrAssign);
+  set(TokenKind::PipePipe, 2, L, Operation::LogicalOr);
+  set(TokenKind::AmpAmp, 3, L, Operation::LogicalAnd);
+  set(TokenKind::Pipe, 4, L, Operation::BitOr);
+  set(TokenKind::Caret, 5, L, Operation::BitXor);
+  set(TokenKind::Amp, 6, L, Operation::BitAnd);
+  set(TokenKind::EqualEqual, 7, L, Operation::Eq);
+  set(TokenKind::ExclamEqual, 7, L, Operation::Ne);
+  set(TokenKind::Lesser, 8, L, Operation::Lt);
+  set(TokenKind::LesserEqual, 8, L, Operation::Le);
+  set(TokenKind::Greater, 8, L, Operation::Gt);
+  set(TokenKind::GreaterEqual, 8, L, Operation::Ge);
+  set(TokenKind::LesserLesser, 9, L, Operation::Shl);
+  set(TokenKind::GreaterGreater, 9, L, Operation::Shr);
+  set(TokenKind::Plus, 10, L, Operation::Add);
+  set(TokenKind::Minus, 10, L, Operation::Sub);
+  set(TokenKind::Asterisk, 11, L, Operation::Mul);
+  set(TokenKind::Slash, 11, L, Operation::Div);
+  set(TokenKind::Percent, 11, L, Operation::Rem);
+  return table;
+}
+
+constexpr std::array<BinaryOperator, TokenKindCount> BinaryOperators =
+    build_binary_operators();
+
+bool get_unary_operation(TokenKind kind, Operation &op) {
+  switch (kind) {
+  case TokenKind::Minus:
+    op = Operation::Neg;
+    return true;
+  case TokenKind::Exclam:
+    op = Operation::Not;
+    return true;
+  case TokenKind::Tilde:
+    op = Operation::BitNot;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool is_literal(TokenKind kind) {
+  switch (kind) {
+  case TokenKind::Numeric:
+  case TokenKind::String:
+  case TokenKind::Identifier:
+  case TokenKind::True:
+  case TokenKind::False:
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+Parser::Parser(Lexer &lexer) : lexer(lexer) {
+  this->window.reserve(WindowSize);
+}
+
+void Parser::set_times(PhaseTimes *times) { this->times = times; }
+
+const Ast &Parser::get_ast() const { return this->ast; }
+
+Ast Parser::take_ast() { return std::move(this->ast); }
+
+NodeId Parser::get_root() const { return this->root; }
+
+ParserErrorCode Parser::get_error() const { return this->errorCode; }
+
+uint32_t Parser::get_error_offset() const { return this->errorOffset; }
+
+void Parser::error(ParserErrorCode code) {
+  this->errorCode = code;
+  this->errorOffset = this->peek().offset;
+}
+
+bool Parser::expect(TokenKind kind, ParserErrorCode code) {
+  if (this->peek_kind() != kind) {
+    this->error(code);
+    return false;
+  }
+  this->advance();
+  return true;
 }
 
-bool Parser::eof() {
-  return this->tokens[this->current].kind == TokenKind::Eof;
+void Parser::refill() {
+  PhaseScope scope(this->times, Phase::Lex);
+  this->window.erase_front(this->current);
+  this->current = 0;
+  while (!this->lexed_eof && this->window.size() < WindowSize) {
+    const Token token = this->lexer.next();
+    this->window.push_back(token);
+    this->lexed_eof = token.kind == TokenKind::Eof;
+  }
 }
 
-const TokenKind Parser::peek_kind() { return this->tokens[this->current].kind; }
+bool Parser::eof() { return this->peek_kind() == TokenKind::Eof; }
 
-const TokenKind Parser::peek_kind(int32_t next) {
-  return this->tokens[this->current + next].kind;
+Token Parser::peek(uint32_t next) {
+  assert(next < Lookahead && "lookahead past the token window");
+  if (this->current + next >= this->window.size()) {
+    this->refill();
+  }
+  // Past the end of the input the Eof token repeats.
+  const uint32_t last = this->window.size() - 1;
+  return this->window.get(std::min(this->current + next, last));
+}
+
+const TokenKind Parser::peek_kind() {
+  if (this->current >= this->window.size()) {
+    this->refill();
+  }
+  return this->window.get_kind(this->current);
 }
 
+const TokenKind Parser::peek_kind(uint32_t next) {
+  assert(next < Lookahead && "lookahead past the token window");
+  if (this->current + next >= this->window.size()) {
+    this->refill();
+  }
+  const uint32_t last = this->window.size() - 1;
+  return this->window.get_kind(std::min(this->current + next, last));
+}
+
+Token Parser::advance() {
+  const Token token = this->peek();
+  if (token.kind != TokenKind::Eof) {
+    ++this->current;
+  }
+  return token;
+}
+
+// Blocks nest without recursion: the statements of every open block wait
+// at the end of one vector until their closing brace.
 void Parser::parse() {
-  if (this->tokens.size() == 0) {
-    return;
+  std::vector<NodeId> statements;
+  // Start in `statements` and offset of each open block.
+  std::vector<std::pair<uint32_t, uint32_t>> blocks;
+  while (true) {
+    const TokenKind kind = this->peek_kind();
+    if (kind == TokenKind::Eof) {
+      if (!blocks.empty()) {
+        this->error(ParserErrorCode::ExpectedRBrace);
+        return;
+      }
+      break;
+    }
+    if (kind == TokenKind::LBrace) {
+      blocks.emplace_back(static_cast<uint32_t>(statements.size()),
+                          this->advance().offset);
+      continue;
+    }
+    if (kind == TokenKind::RBrace && !blocks.empty()) {
+      this->advance();
+      const auto [start, offset] = blocks.back();
+      blocks.pop_back();
+      const NodeId block = this->ast.add_block(
+          offset, llvm::ArrayRef<NodeId>(statements).drop_front(start));
+      statements.resize(start);
+      statements.push_back(block);
+      continue;
+    }
+
+    llvm::TimeTraceScope scope("Statement", [this] {
+      const Token first = this->peek();
+      std::string detail = first.to_strref(this->lexer.get_buffer()).str();
+      if (first.kind == TokenKind::Let || first.kind == TokenKind::Type) {
+        detail += ' ';
+        detail += this->peek(1).to_strref(this->lexer.get_buffer()).str();
+      }
+      return detail;
+    });
+    const NodeId statement = this->parse_statement();
+    if (!statement.is_valid()) {
+      return;
+    }
+    statements.push_back(statement);
   }
-  Token token = this->tokens[this->current];
+  this->root = this->ast.add_list(0, statements);
+}
 
-  while (!this->eof()) {
-    const TokenKind ctk = this->peek_kind();
+NodeId Parser::parse_statement() {
+  if (this->peek_kind() == TokenKind::Let) {
+    return this->parse_let();
+  }
+  if (this->peek_kind() == TokenKind::Type) {
+    return this->parse_alias();
+  }
+  const NodeId expression = this->parse_expression();
+  if (!expression.is_valid() ||
+      !this->expect(TokenKind::Semicolon, ParserErrorCode::ExpectedSemicolon)) {
+    return NodeId();
+  }
+  return expression;
+}
 
-		switch (ctk) {
+// let <identifier> = <expression> ;
+NodeId Parser::parse_let() {
+  const uint32_t offset = this->advance().offset;
+  if (this->peek_kind() != TokenKind::Identifier) {
+    this->error(ParserErrorCode::ExpectedIdentifier);
+    return NodeId();
+  }
+  const Symbol name(this->advance().payload);
+  if (!this->expect(TokenKind::Equal, ParserErrorCode::ExpectedEqual)) {
+    return NodeId();
+  }
+  const NodeId init = this->parse_expression();
+  if (!init.is_valid() ||
+      !this->expect(TokenKind::Semicolon, ParserErrorCode::ExpectedSemicolon)) {
+    return NodeId();
+  }
+  return this->ast.add_let(offset, name, init);
+}
 
-		};
+// type <identifier> = ( <identifier> | <path> ) ;
+NodeId Parser::parse_alias() {
+  const uint32_t offset = this->advance().offset;
+  if (this->peek_kind() != TokenKind::Identifier) {
+    this->error(ParserErrorCode::ExpectedIdentifier);
+    return NodeId();
+  }
+  const Symbol name(this->advance().payload);
+  if (!this->expect(TokenKind::Equal, ParserErrorCode::ExpectedEqual)) {
+    return NodeId();
+  }
+  NodeId target;
+  if (this->peek_kind() == TokenKind::Identifier) {
+    const Token token = this->advance();
+    target = this->ast.add_identifier(token.offset, Symbol(token.payload));
+  } else if (this->peek_kind() == TokenKind::At) {
+    target = this->parse_path();
+  } else {
+    this->error(ParserErrorCode::ExpectedIdentifier);
+  }
+  if (!target.is_valid() ||
+      !this->expect(TokenKind::Semicolon, ParserErrorCode::ExpectedSemicolon)) {
+    return NodeId();
+  }
+  return this->ast.add_alias(offset, name, target);
+}
+
+// Precedence climbing over explicit operand and operator stacks instead of
+// the call stack, so arbitrarily deep nesting costs heap, not recursion.
+// Prefix operators and open parentheses wait on the operator stack like
+// binary operators do.
+NodeId Parser::parse_expression() {
+  this->operands.clear();
+  this->operators.clear();
+  uint32_t open_parens = 0;
+  bool expect_operand = true;
+
+  while (true) {
+    const TokenKind kind = this->peek_kind();
+
+    if (expect_operand) {
+      Operation op;
+      if (get_unary_operation(kind, op)) {
+        this->operators.push_back(
+            {PendingOp::Unary, op, UnaryPrecedence, this->advance().offset});
+      } else if (kind == TokenKind::LParen) {
+        this->operators.push_back(
+            {PendingOp::Paren, Operation(), 0, this->advance().offset});
+        ++open_parens;
+      } else if (kind == TokenKind::At) {
+        const NodeId path = this->parse_path();
+        if (!path.is_valid()) {
+          return NodeId();
+        }
+        this->operands.push_back(path);
+        expect_operand = false;
+      } else if (is_literal(kind)) {
+        this->operands.push_back(
+            this->ast.add_literal(this->advance(), this->lexer));
+        expect_operand = false;
+      } else {
+        this->error(ParserErrorCode::ExpectedExpression);
+        return NodeId();
+      }
+      continue;
+    }
+
+    const BinaryOperator &binary = BinaryOperators[static_cast<size_t>(kind)];
+    if (binary.precedence != 0) {
+      while (!this->operators.empty()) {
+        const PendingOp &top = this->operators.back();
+        if (top.kind == PendingOp::Paren ||
+            top.precedence < binary.precedence ||
+            (top.precedence == binary.precedence &&
+             binary.associativity == Associativity::Right)) {
+          break;
+        }
+        this->reduce();
+      }
+      this->operators.push_back({PendingOp::Binary, binary.op,
+                                 binary.precedence, this->advance().offset});
+      expect_operand = true;
+    } else if (kind == TokenKind::RParen && open_parens > 0) {
+      while (this->operators.back().kind != PendingOp::Paren) {
+        this->reduce();
+      }
+      this->operators.pop_back();
+      --open_parens;
+      this->advance();
+    } else {
+      break;
+    }
+  }
+
+  if (open_parens > 0) {
+    this->error(ParserErrorCode::ExpectedRParen);
+    return NodeId();
+  }
+  while (!this->operators.empty()) {
+    this->reduce();
+  }
+  assert(this->operands.size() == 1);
+  return this->operands.back();
+}
+
+// @ { <identifier> ( . <identifier> )* } :: <identifier>
+NodeId Parser::parse_path() {
+  const uint32_t offset = this->advance().offset;
+  if (!this->expect(TokenKind::LBrace, ParserErrorCode::ExpectedLBrace)) {
+    return NodeId();
+  }
+  Interner &interner = this->lexer.get_interner();
+  std::string module;
+  while (true) {
+    if (this->peek_kind() != TokenKind::Identifier) {
+      this->error(ParserErrorCode::ExpectedIdentifier);
+      return NodeId();
+    }
+    module += interner.get_spelling(Symbol(this->advance().payload));
+    if (this->peek_kind() != TokenKind::Dot) {
+      break;
+    }
+    module += '.';
+    this->advance();
+  }
+  if (!this->expect(TokenKind::RBrace, ParserErrorCode::ExpectedRBrace) ||
+      !this->expect(TokenKind::ColonColon,
+                    ParserErrorCode::ExpectedColonColon)) {
+    return NodeId();
+  }
+  if (this->peek_kind() != TokenKind::Identifier) {
+    this->error(ParserErrorCode::ExpectedIdentifier);
+    return NodeId();
+  }
+  const Symbol name(this->advance().payload);
+  return this->ast.add_path(offset, interner.intern(module), name);
+}
+
+// Pops the operator on top of the stack and applies it to its operands.
+void Parser::reduce() {
+  const PendingOp pending = this->operators.back();
+  this->operators.pop_back();
+  if (pending.kind == PendingOp::Unary) {
+    const NodeId operand = this->operands.back();
+    this->operands.back() =
+        this->ast.add_unary(pending.offset, pending.op, operand);
+    return;
   }
+  assert(pending.kind == PendingOp::Binary);
+  const NodeId rhs = this->operands.back();
+  this->operands.pop_back();
+  const NodeId lhs = this->operands.back();
+  this->operands.back() =
+      this->ast.add_binary(pending.offset, pending.op, lhs, rhs);
 }
@@ -1,24 +1,91 @@
 #ifndef MR_MRC_PARSER_H
 #define MR_MRC_PARSER_H
 
+#include "AST.h"
 #include "Lexer.h"
+#include "Timing.h"
+#include "TokenBuffer.h"
 
-#include <list>
+#include <cstdint>
 #include <vector>
 
+enum class ParserErrorCode {
+  NoError = 0,
+  ExpectedExpression,
+  ExpectedRParen,
+  ExpectedIdentifier,
+  ExpectedEqual,
+  ExpectedSemicolon,
+  ExpectedLBrace,
+  ExpectedRBrace,
+  ExpectedColonColon,
+};
+
 class Parser {
 public:
-  Parser(std::list<Token> tokens);
+  Parser(Lexer &lexer);
   virtual ~Parser() = default;
+  // Parses the whole input into a List of statements, see get_root().
+  // Blocks in braces nest as Block statements.
+  // Parsing stops at the first error.
   void parse();
 
+  // Time spent pulling tokens from the lexer is added to `times`.
+  void set_times(PhaseTimes *times);
+
+  const Ast &get_ast() const;
+  // Moves the tree out of the parser, leaving it empty.
+  Ast take_ast();
+  NodeId get_root() const;
+
+  ParserErrorCode get_error() const;
+  // Byte offset of the token that caused the error.
+  uint32_t get_error_offset() const;
+
 private:
-  size_t current = 0;
-  std::vector<Token> tokens;
+  // Tokens are pulled from the lexer in batches of up to WindowSize into a
+  // struct-of-arrays window; lookahead and dispatch only read its kind
+  // array. At most Lookahead tokens past the current one may be peeked.
+  static constexpr uint32_t Lookahead = 8;
+  static constexpr uint32_t WindowSize = 4096;
+
+  // An operator waiting on the stack for its right operand, or an open
+  // parenthesis.
+  struct PendingOp {
+    enum Kind : uint8_t { Unary, Binary, Paren } kind;
+    Operation op;
+    uint8_t precedence;
+    uint32_t offset;
+  };
+
+  Lexer &lexer;
+  TokenBuffer window;
+  uint32_t current = 0;
+  bool lexed_eof = false;
+  PhaseTimes *times = nullptr;
+
+  Ast ast;
+  NodeId root;
+  std::vector<NodeId> operands;
+  std::vector<PendingOp> operators;
+  ParserErrorCode errorCode = ParserErrorCode::NoError;
+  uint32_t errorOffset = 0;
+
+  NodeId parse_statement();
+  NodeId parse_let();
+  NodeId parse_alias();
+  NodeId parse_expression();
+  NodeId parse_path();
+  void reduce();
+  bool expect(TokenKind kind, ParserErrorCode code);
+  void error(ParserErrorCode code);
 
+  void refill();
   bool eof();
+  Token peek(uint32_t next = 0);
   const TokenKind peek_kind();
-  const TokenKind peek_kind(int32_t next);
+  const TokenKind peek_kind(uint32_t next);
+  Token advance();
 };
 
 #endif
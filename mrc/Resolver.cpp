@@ -0,0 +1,134 @@
+#include "Resolver.h"
+
+#include <cassert>
+
+Resolver::Resolver(Ast &ast) : ast(ast) {}
+
+llvm::ArrayRef<Declaration> Resolver::get_declarations() const {
+  return this->declarations;
+}
+
+ResolveErrorCode Resolver::get_error() const { return this->errorCode; }
+
+uint32_t Resolver::get_error_offset() const { return this->errorOffset; }
+
+bool Resolver::error(ResolveErrorCode code, NodeId node) {
+  this->errorCode = code;
+  this->errorOffset = this->ast.get_offset(node);
+  return false;
+}
+
+// Blocks nest as deep as the parser allows, so they are walked with an
+// explicit stack rather than by recursion.
+bool Resolver::resolve(NodeId root) {
+  this->symbols = SymbolTable();
+  this->declarations.clear();
+  this->frames.clear();
+  this->errorCode = ResolveErrorCode::NoError;
+  this->errorOffset = 0;
+  if (!root.is_valid()) {
+    return true;
+  }
+
+  this->frames.push_back({root, 0});
+  while (!this->frames.empty()) {
+    Frame &frame = this->frames.back();
+    const llvm::ArrayRef<NodeId> statements = this->ast.get_list(frame.block);
+    if (frame.next == statements.size()) {
+      if (this->ast.get_kind(frame.block) == NodeKind::Block) {
+        this->symbols.pop_scope();
+      }
+      this->frames.pop_back();
+      continue;
+    }
+    const NodeId statement = statements[frame.next++];
+
+    switch (this->ast.get_kind(statement)) {
+    case NodeKind::Block:
+      this->symbols.push_scope();
+      this->frames.push_back({statement, 0});
+      break;
+    case NodeKind::Let: {
+      // The initializer still sees what the name shadows.
+      if (!this->resolve_expression(this->ast.get_let_init(statement))) {
+        return false;
+      }
+      const Declaration::Kind kind = this->symbols.is_module_scope()
+                                         ? Declaration::Global
+                                         : Declaration::Local;
+      this->declarations.push_back({kind, statement});
+      if (!this->declare(this->ast.get_let_name(statement),
+                         this->declarations.size() - 1, statement)) {
+        return false;
+      }
+      break;
+    }
+    case NodeKind::Alias: {
+      const NodeId target = this->ast.get_alias_target(statement);
+      uint32_t declaration;
+      if (this->ast.get_kind(target) == NodeKind::Identifier) {
+        if (!this->resolve_identifier(target)) {
+          return false;
+        }
+        declaration = this->ast.get_declaration(target);
+      } else {
+        this->declarations.push_back({Declaration::Import, target});
+        declaration = this->declarations.size() - 1;
+      }
+      if (!this->declare(this->ast.get_alias_name(statement), declaration,
+                         statement)) {
+        return false;
+      }
+      break;
+    }
+    default:
+      if (!this->resolve_expression(statement)) {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+bool Resolver::resolve_expression(NodeId node) {
+  this->pending.assign(1, node);
+  while (!this->pending.empty()) {
+    const NodeId next = this->pending.back();
+    this->pending.pop_back();
+    switch (this->ast.get_kind(next)) {
+    case NodeKind::Identifier:
+      if (!this->resolve_identifier(next)) {
+        return false;
+      }
+      break;
+    case NodeKind::Unary:
+      this->pending.push_back(this->ast.get_operand(next));
+      break;
+    case NodeKind::Binary:
+      this->pending.push_back(this->ast.get_rhs(next));
+      this->pending.push_back(this->ast.get_lhs(next));
+      break;
+    default:
+      break;
+    }
+  }
+  return true;
+}
+
+bool Resolver::resolve_identifier(NodeId node) {
+  const uint32_t declaration =
+      this->symbols.lookup(this->ast.get_symbol(node));
+  if (declaration == SymbolTable::NotFound) {
+    return this->error(ResolveErrorCode::UndeclaredIdentifier, node);
+  }
+  this->ast.set_declaration(node, declaration);
+  return true;
+}
+
+bool Resolver::declare(Symbol name, uint32_t declaration, NodeId node) {
+  if (!this->symbols.declare(name, declaration)) {
+    return this->error(ResolveErrorCode::Redefinition, node);
+  }
+  return true;
+}
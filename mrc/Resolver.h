@@ -0,0 +1,58 @@
+#ifndef MR_MRC_RESOLVER_H
+#define MR_MRC_RESOLVER_H
+
+#include "AST.h"
+#include "SymbolTable.h"
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include <cstdint>
+#include <vector>
+
+enum class ResolveErrorCode {
+  NoError = 0,
+  UndeclaredIdentifier,
+  Redefinition,
+};
+
+// Binds every Identifier in an Ast to the Declaration it names, in place,
+// so that later passes index declarations instead of looking names up.
+//
+// A name is visible from the statement after its declaration to the end of
+// the enclosing block, and a block may shadow names from outside it.
+// Declarations are numbered in source order.
+class Resolver {
+public:
+  explicit Resolver(Ast &ast);
+
+  // Returns false at the first error.
+  bool resolve(NodeId root);
+
+  llvm::ArrayRef<Declaration> get_declarations() const;
+
+  ResolveErrorCode get_error() const;
+  // Byte offset of the node that caused the last error.
+  uint32_t get_error_offset() const;
+
+private:
+  // A List or Block whose statements before `next` are resolved.
+  struct Frame {
+    NodeId block;
+    uint32_t next;
+  };
+
+  Ast &ast;
+  SymbolTable symbols;
+  std::vector<Declaration> declarations;
+  std::vector<Frame> frames;
+  std::vector<NodeId> pending;
+  ResolveErrorCode errorCode = ResolveErrorCode::NoError;
+  uint32_t errorOffset = 0;
+
+  bool resolve_expression(NodeId node);
+  bool resolve_identifier(NodeId node);
+  bool declare(Symbol name, uint32_t declaration, NodeId node);
+  bool error(ResolveErrorCode code, NodeId node);
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "SourceManager.h"
+#include "CharScan.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
+
+std::optional<FileID> SourceManager::load_file(const fs::path &path,
+                                               llvm::raw_ostream &errs) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+      llvm::MemoryBuffer::getFileOrSTDIN(path.string(), /*IsText=*/false,
+                                         /*RequiresNullTerminator=*/true);
+  if (!buffer) {
+    errs << "Error opening \"" << path.string()
+         << "\": " << buffer.getError().message() << "\n";
+    return std::nullopt;
+  }
+
+  if ((*buffer)->getBufferSize() > std::numeric_limits<uint32_t>::max()) {
+    errs << "Error opening \"" << path.string() << "\": file exceeds 4 GiB\n";
+    return std::nullopt;
+  }
+
+  return this->add_buffer(std::move(*buffer));
+}
+
+FileID SourceManager::add_buffer(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  auto file = std::make_unique<File>();
+  file->buffer = std::move(buffer);
+  std::lock_guard<std::mutex> guard(this->lock);
+  this->files.push_back(std::move(file));
+  return FileID(static_cast<uint32_t>(this->files.size()));
+}
+
+// Files are never removed, so the reference outlives the lock.
+SourceManager::File &SourceManager::get_file(FileID file) const {
+  std::lock_guard<std::mutex> guard(this->lock);
+  assert(file.is_valid() && file.get_raw() <= this->files.size());
+  return *this->files[file.get_raw() - 1];
+}
+
+llvm::StringRef SourceManager::get_buffer(FileID file) const {
+  return this->get_file(file).buffer->getBuffer();
+}
+
+llvm::StringRef SourceManager::get_name(FileID file) const {
+  return this->get_file(file).buffer->getBufferIdentifier();
+}
+
+LineColumn SourceManager::get_line_column(SourceLocation location) const {
+  File &file = this->get_file(location.file);
+  std::call_once(file.lines_built, build_lines, std::ref(file));
+
+  const llvm::StringRef buffer = file.buffer->getBuffer();
+  const uint32_t offset =
+      std::min(location.offset, static_cast<uint32_t>(buffer.size()));
+  const auto next = std::upper_bound(file.line_starts.begin(),
+                                     file.line_starts.end(), offset);
+  const uint32_t line_start = *(next - 1);
+
+  uint32_t column = 1;
+  for (char c : buffer.slice(line_start, offset)) {
+    column += (static_cast<uint8_t>(c) & 0xC0) != 0x80;
+  }
+  return {static_cast<uint32_t>(next - file.line_starts.begin()), column};
+}
+
+void SourceManager::build_lines(File &file) {
+  const char *start = file.buffer->getBufferStart();
+  const char *end = file.buffer->getBufferEnd();
+  file.line_starts.push_back(0);
+  for (const char *cur = CharScan::find_line_end(start, end); cur != end;
+       cur = CharScan::find_line_end(cur, end)) {
+    if (*cur == '\r' && end - cur >= 2 && cur[1] == '\n') {
+      cur += 2;
+    } else if (*cur == '\xE2') {
+      cur += 3; // LS or PS
+    } else {
+      ++cur;
+    }
+    file.line_starts.push_back(static_cast<uint32_t>(cur - start));
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef MR_MRC_SOURCEMANAGER_H
+#define MR_MRC_SOURCEMANAGER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Handle to a file owned by a SourceManager. The zero id is never handed out.
+class FileID {
+public:
+  FileID() = default;
+
+  bool is_valid() const { return this->id != 0; }
+  uint32_t get_raw() const { return this->id; }
+
+  bool operator==(const FileID &other) const { return this->id == other.id; }
+  bool operator!=(const FileID &other) const { return this->id != other.id; }
+
+private:
+  friend class SourceManager;
+  explicit FileID(uint32_t id) : id(id) {}
+
+  uint32_t id = 0;
+};
+
+// A byte offset into a file, valid for as long as its SourceManager lives.
+struct SourceLocation {
+  FileID file;
+  uint32_t offset = 0;
+};
+
+// 1-based position of a SourceLocation. Columns count code points.
+struct LineColumn {
+  uint32_t line;
+  uint32_t column;
+};
+
+// Owns every loaded file. Safe to use from several threads at once.
+class SourceManager {
+public:
+  SourceManager() = default;
+  SourceManager(const SourceManager &) = delete;
+  SourceManager &operator=(const SourceManager &) = delete;
+
+  // Maps the file into memory once. Pipes and stdin ("-") are read in a
+  // single pass instead. Every buffer is followed by a '\0' sentinel.
+  // Failures are reported to `errs`.
+  std::optional<FileID> load_file(const fs::path &path,
+                                  llvm::raw_ostream &errs = llvm::errs());
+  FileID add_buffer(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  llvm::StringRef get_buffer(FileID file) const;
+  llvm::StringRef get_name(FileID file) const;
+
+  // Only diagnostics need lines, so a file's line table is built the first
+  // time one of its locations is resolved. LF, CR, CRLF, LS and PS all end
+  // a line.
+  LineColumn get_line_column(SourceLocation location) const;
+
+private:
+  struct File {
+    std::unique_ptr<llvm::MemoryBuffer> buffer;
+    std::once_flag lines_built;
+    // Offset of the first byte of every line.
+    std::vector<uint32_t> line_starts;
+  };
+
+  mutable std::mutex lock;
+  std::vector<std::unique_ptr<File>> files;
+
+  File &get_file(FileID file) const;
+  static void build_lines(File &file);
+};
+
+#endif
@@ -2,8 +2,6 @@
 #define MR_MRC_STRINGUTIL_H
 
 #include <cstdint>
-#include <fstream>
-#include <iostream>
 #include <string>
 
 class StringUtil {
@@ -46,41 +44,19 @@ public:
     return result;
   }
 
-  static const uint32_t utf8_from_file(std::ifstream &file, uint8_t first) {
-    int num_bytes = utf8_char_length(first);
-    uint32_t code_point = 0;
-
-    if ((first & 0b10000000) == 0) {
-      num_bytes = 1;
-      code_point = first;
-    } else if ((first & 0b11100000) == 0b11000000) {
-      num_bytes = 2;
-      code_point = first & 0b00011111;
-    } else if ((first & 0b11110000) == 0b11100000) {
-      num_bytes = 3;
-      code_point = first & 0b00001111;
-    } else if ((first & 0b11111000) == 0b11110000) {
-      num_bytes = 4;
-      code_point = first & 0b00000111;
-    } else {
-      return code_point;
+  // Decodes the code point starting with `first`, advancing `cur` past its
+  // continuation bytes. The input must already be valid UTF-8, see
+  // CharScan::validate_utf8.
+  static const uint32_t utf8_from_buffer(const char *&cur, uint8_t first) {
+    const int num_bytes = utf8_char_length(first);
+    if (num_bytes <= 1) {
+      return first;
     }
 
+    uint32_t code_point = first & (0x7F >> num_bytes);
     for (int i = 1; i < num_bytes; ++i) {
-      int next = file.get();
-      if (next == EOF) {
-        std::cerr << "Unexpected EOF during UTF-8 decoding\n";
-        return code_point;
-      }
-      unsigned char c = static_cast<unsigned char>(next);
-      if ((c & 0b11000000) != 0b10000000) {
-        std::cerr << "Invalid UTF-8 continuation byte: 0x" << std::hex << (int)c
-                  << std::dec << "\n";
-        return code_point;
-      }
-      code_point = (code_point << 6) | (c & 0b00111111);
+      code_point = (code_point << 6) | (static_cast<uint8_t>(*cur++) & 0x3F);
     }
-
     return code_point;
   }
 
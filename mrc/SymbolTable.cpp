@@ -0,0 +1,98 @@
+#include "SymbolTable.h"
+
+#include <cassert>
+
+namespace {
+
+constexpr uint32_t InitialBits = 6;
+
+// Symbols are dense ids, so consecutive ones must not probe consecutive
+// slots: Fibonacci hashing spreads them over the table by the high bits.
+uint32_t get_hash(Symbol name) { return name.get_raw() * 0x9E3779B9u; }
+
+} // namespace
+
+SymbolTable::SymbolTable()
+    : slots(size_t(1) << InitialBits), shift(32 - InitialBits) {}
+
+void SymbolTable::push_scope() {
+  this->scopes.push_back(static_cast<uint32_t>(this->locals.size()));
+}
+
+void SymbolTable::pop_scope() {
+  assert(!this->scopes.empty());
+  for (uint32_t i = static_cast<uint32_t>(this->locals.size());
+       i > this->scopes.back(); --i) {
+    const Local &local = this->locals[i - 1];
+    this->innermost[local.name.get_raw()] = local.shadowed;
+  }
+  this->locals.resize(this->scopes.back());
+  this->scopes.pop_back();
+}
+
+bool SymbolTable::is_module_scope() const { return this->scopes.empty(); }
+
+bool SymbolTable::declare(Symbol name, uint32_t declaration) {
+  assert(name.is_valid());
+  if (!this->scopes.empty()) {
+    const uint32_t depth = static_cast<uint32_t>(this->scopes.size());
+    const uint32_t shadowed = this->find_local(name);
+    if (shadowed != NotFound && this->locals[shadowed].depth == depth) {
+      return false;
+    }
+    if (name.get_raw() >= this->innermost.size()) {
+      this->innermost.resize(name.get_raw() + 1, NotFound);
+    }
+    this->innermost[name.get_raw()] =
+        static_cast<uint32_t>(this->locals.size());
+    this->locals.push_back({name, declaration, depth, shadowed});
+    return true;
+  }
+
+  Entry &slot = this->slots[this->find_slot(name)];
+  if (slot.name.is_valid()) {
+    return false;
+  }
+  slot = {name, declaration};
+  if (++this->count * 2 > this->slots.size()) {
+    this->grow();
+  }
+  return true;
+}
+
+uint32_t SymbolTable::lookup(Symbol name) const {
+  const uint32_t local = this->find_local(name);
+  if (local != NotFound) {
+    return this->locals[local].declaration;
+  }
+  const Entry &slot = this->slots[this->find_slot(name)];
+  return slot.name.is_valid() ? slot.declaration : NotFound;
+}
+
+// Index of the innermost open local named `name`, or NotFound.
+uint32_t SymbolTable::find_local(Symbol name) const {
+  return name.get_raw() < this->innermost.size()
+             ? this->innermost[name.get_raw()]
+             : NotFound;
+}
+
+// The slot holding `name`, or the empty slot where it would go.
+uint32_t SymbolTable::find_slot(Symbol name) const {
+  const uint32_t mask = static_cast<uint32_t>(this->slots.size()) - 1;
+  uint32_t slot = get_hash(name) >> this->shift;
+  while (this->slots[slot].name.is_valid() && this->slots[slot].name != name) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+void SymbolTable::grow() {
+  std::vector<Entry> old(this->slots.size() * 2);
+  old.swap(this->slots);
+  --this->shift;
+  for (const Entry &entry : old) {
+    if (entry.name.is_valid()) {
+      this->slots[this->find_slot(entry.name)] = entry;
+    }
+  }
+}
@@ -0,0 +1,64 @@
+#ifndef MR_MRC_SYMBOLTABLE_H
+#define MR_MRC_SYMBOLTABLE_H
+
+#include "Interner.h"
+
+#include <cstdint>
+#include <vector>
+
+// Maps the names in scope to declaration indices during name resolution.
+//
+// Module-level names live in an open-addressing table keyed by Symbol id.
+// Block scopes are one flat vector of entries with the start of each open
+// scope on a marker stack. Symbols are dense, so a vector indexed by them
+// points at each name's innermost local, which links to the local it
+// shadows. Declaring, redefinition checks and lookups are O(1); leaving a
+// scope unlinks its entries and truncates. Nothing is allocated per scope
+// or per name once the vectors have grown.
+class SymbolTable {
+public:
+  static constexpr uint32_t NotFound = UINT32_MAX;
+
+  SymbolTable();
+
+  void push_scope();
+  void pop_scope();
+  bool is_module_scope() const;
+
+  // Declares `name` in the innermost scope. Returns false if that scope
+  // already declares it; outer declarations are shadowed.
+  bool declare(Symbol name, uint32_t declaration);
+  uint32_t lookup(Symbol name) const;
+
+private:
+  struct Entry {
+    Symbol name;
+    uint32_t declaration;
+  };
+
+  struct Local {
+    Symbol name;
+    uint32_t declaration;
+    // Number of scopes open when it was declared.
+    uint32_t depth;
+    // The local it shadows, or NotFound.
+    uint32_t shadowed;
+  };
+
+  std::vector<Local> locals;
+  std::vector<uint32_t> scopes;
+  // By Symbol id: the innermost local of that name, or NotFound.
+  std::vector<uint32_t> innermost;
+  // Empty slots have an invalid name. The size is a power of two, at most
+  // half full.
+  std::vector<Entry> slots;
+  // 32 minus log2 of the number of slots.
+  uint32_t shift;
+  uint32_t count = 0;
+
+  uint32_t find_slot(Symbol name) const;
+  uint32_t find_local(Symbol name) const;
+  void grow();
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "Timing.h"
+
+#include "llvm/Support/Format.h"
+
+#include <chrono>
+#include <ctime>
+
+namespace {
+
+double get_wall_seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double get_thread_cpu_seconds() {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+  return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+} // namespace
+
+PhaseTimes &PhaseTimes::operator+=(const PhaseTimes &other) {
+  for (size_t i = 0; i < PhaseCount; ++i) {
+    this->times[i].wall += other.times[i].wall;
+    this->times[i].cpu += other.times[i].cpu;
+  }
+  return *this;
+}
+
+const char *PhaseTimes::get_name(Phase phase) {
+  switch (phase) {
+  case Phase::Load:
+    return "Load";
+  case Phase::Lex:
+    return "Lex";
+  case Phase::Parse:
+    return "Parse";
+  case Phase::Resolve:
+    return "Resolve";
+  case Phase::Fold:
+    return "Fold";
+  case Phase::Codegen:
+    return "Codegen";
+  }
+  return "Unknown";
+}
+
+void PhaseTimes::print(llvm::raw_ostream &os, double elapsed) const {
+  Time total;
+  for (const Time &time : this->times) {
+    total.wall += time.wall;
+    total.cpu += time.cpu;
+  }
+
+  os << "===" << std::string(60, '-') << "===\n"
+     << "                        mrc time report\n"
+     << "===" << std::string(60, '-') << "===\n"
+     << "  Total elapsed wall time: " << llvm::format("%.4f", elapsed)
+     << " seconds\n\n"
+     << "   ---Wall Time---   ---CPU Time---   --Phase--\n";
+  auto row = [&os, &total](const Time &time, llvm::StringRef name) {
+    const double wall_share = total.wall > 0 ? time.wall / total.wall : 0;
+    const double cpu_share = total.cpu > 0 ? time.cpu / total.cpu : 0;
+    os << llvm::format("   %7.4f (%5.1f%%)  %7.4f (%5.1f%%)  ", time.wall,
+                       wall_share * 100, time.cpu, cpu_share * 100)
+       << name << "\n";
+  };
+  for (size_t i = 0; i < PhaseCount; ++i) {
+    row(this->times[i], get_name(static_cast<Phase>(i)));
+  }
+  row(total, "Total");
+}
+
+PhaseScope::PhaseScope(PhaseTimes *times, Phase phase)
+    : PhaseScope(times, phase, llvm::StringRef()) {}
+
+PhaseScope::PhaseScope(PhaseTimes *times, Phase phase, llvm::StringRef detail)
+    : times(times), phase(phase),
+      trace(PhaseTimes::get_name(phase), detail) {
+  if (this->times != nullptr) {
+    this->wall_start = get_wall_seconds();
+    this->cpu_start = get_thread_cpu_seconds();
+  }
+}
+
+PhaseScope::~PhaseScope() {
+  if (this->times != nullptr) {
+    PhaseTimes::Time &time = (*this->times)[this->phase];
+    time.wall += get_wall_seconds() - this->wall_start;
+    time.cpu += get_thread_cpu_seconds() - this->cpu_start;
+  }
+}
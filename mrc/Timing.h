@@ -0,0 +1,68 @@
+#ifndef MR_MRC_TIMING_H
+#define MR_MRC_TIMING_H
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class Phase : uint8_t {
+  Load,
+  Lex,
+  Parse,
+  Resolve,
+  Fold,
+  Codegen,
+};
+
+inline constexpr size_t PhaseCount = static_cast<size_t>(Phase::Codegen) + 1;
+
+// Wall and CPU seconds spent in each phase. CPU time is that of the calling
+// thread, so times collected on different threads add up correctly.
+class PhaseTimes {
+public:
+  struct Time {
+    double wall = 0;
+    double cpu = 0;
+  };
+
+  Time &operator[](Phase phase) {
+    return this->times[static_cast<size_t>(phase)];
+  }
+  const Time &operator[](Phase phase) const {
+    return this->times[static_cast<size_t>(phase)];
+  }
+  PhaseTimes &operator+=(const PhaseTimes &other);
+
+  // Prints one row per phase and their total. `elapsed` is the wall time of
+  // the whole run, which is less than the total when files ran in parallel.
+  void print(llvm::raw_ostream &os, double elapsed) const;
+
+  static const char *get_name(Phase phase);
+
+private:
+  std::array<Time, PhaseCount> times;
+};
+
+// Adds the time between construction and destruction to one phase of
+// `times`, if it is not null, and records it as a time-trace event named
+// after the phase.
+class PhaseScope {
+public:
+  PhaseScope(PhaseTimes *times, Phase phase);
+  PhaseScope(PhaseTimes *times, Phase phase, llvm::StringRef detail);
+  ~PhaseScope();
+  PhaseScope(const PhaseScope &) = delete;
+  PhaseScope &operator=(const PhaseScope &) = delete;
+
+private:
+  PhaseTimes *times;
+  Phase phase;
+  double wall_start = 0;
+  double cpu_start = 0;
+  llvm::TimeTraceScope trace;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "TokenBuffer.h"
+
+#include <cassert>
+
+void TokenBuffer::push_back(const Token &token) {
+  this->kinds.push_back(token.kind);
+  this->offsets.push_back(token.offset);
+  this->lengths.push_back(token.length);
+  this->payloads.push_back(token.payload);
+}
+
+void TokenBuffer::reserve(uint32_t capacity) {
+  this->kinds.reserve(capacity);
+  this->offsets.reserve(capacity);
+  this->lengths.reserve(capacity);
+  this->payloads.reserve(capacity);
+}
+
+void TokenBuffer::clear() {
+  this->kinds.clear();
+  this->offsets.clear();
+  this->lengths.clear();
+  this->payloads.clear();
+}
+
+void TokenBuffer::erase_front(uint32_t count) {
+  assert(count <= this->size());
+  this->kinds.erase(this->kinds.begin(), this->kinds.begin() + count);
+  this->offsets.erase(this->offsets.begin(), this->offsets.begin() + count);
+  this->lengths.erase(this->lengths.begin(), this->lengths.begin() + count);
+  this->payloads.erase(this->payloads.begin(), this->payloads.begin() + count);
+}
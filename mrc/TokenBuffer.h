@@ -0,0 +1,40 @@
+#ifndef MR_MRC_TOKENBUFFER_H
+#define MR_MRC_TOKENBUFFER_H
+
+#include "Lexer.h"
+
+#include <cstdint>
+#include <vector>
+
+// A token sequence stored as a struct of arrays. Loops that dispatch on the
+// kind alone read one byte per token instead of a whole Token.
+class TokenBuffer {
+public:
+  void push_back(const Token &token);
+  void reserve(uint32_t capacity);
+  void clear();
+  // Drops the first `count` tokens and moves the rest to the front.
+  void erase_front(uint32_t count);
+
+  uint32_t size() const { return static_cast<uint32_t>(this->kinds.size()); }
+  bool empty() const { return this->kinds.empty(); }
+
+  TokenKind get_kind(uint32_t index) const { return this->kinds[index]; }
+  uint32_t get_offset(uint32_t index) const { return this->offsets[index]; }
+  uint32_t get_length(uint32_t index) const { return this->lengths[index]; }
+  uint32_t get_payload(uint32_t index) const { return this->payloads[index]; }
+  Token get(uint32_t index) const {
+    return Token(this->kinds[index], this->offsets[index],
+                 this->lengths[index], this->payloads[index]);
+  }
+
+  const TokenKind *kind_data() const { return this->kinds.data(); }
+
+private:
+  std::vector<TokenKind> kinds;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> lengths;
+  std::vector<uint32_t> payloads;
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef MR_MRC_VALUETYPE_H
+#define MR_MRC_VALUETYPE_H
+
+#include <cstdint>
+
+// The type CodeGen gives a value: an integer of `width` bits (1 for
+// booleans), a double or a string. Unknown for anything CodeGen rejects.
+struct ValueType {
+  enum Kind : uint8_t { Unknown, Integer, Float, String };
+  Kind kind = Unknown;
+  uint32_t width = 0;
+
+  bool is_bool() const { return this->kind == Integer && this->width == 1; }
+  bool operator==(const ValueType &other) const {
+    return this->kind == other.kind && this->width == other.width;
+  }
+  bool operator!=(const ValueType &other) const { return !(*this == other); }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include "Corpus.h"
+
+#include <vector>
+
+namespace {
+
+// splitmix64: unlike the <random> distributions, its output is the same on
+// every standard library.
+class Random {
+public:
+  explicit Random(uint64_t seed) : state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (this->state += 0x9E3779B97F4A7C15);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+    return z ^ (z >> 31);
+  }
+
+  size_t below(size_t bound) { return this->next() % bound; }
+
+  template <typename T, size_t N> const T &pick(const T (&items)[N]) {
+    return items[this->below(N)];
+  }
+
+private:
+  uint64_t state;
+};
+
+const char *const AsciiParts[] = {"value", "count", "index", "buffer", "node",
+                                  "total", "left",  "right", "item",   "state",
+                                  "x",     "y",     "tmp",   "_",      "$"};
+
+const char *const UnicodeParts[] = {
+    "λ", "αβγ",  "δελτα", "変数", "値", "é", "über", "naïve",
+    "имя", "счёт", "π",   "ñ",    "중간", "ψυχή", "x"};
+
+const char *const Operators[] = {" + ", " - ", " * ", " / ", " % ",
+                                 " << ", " >> ", " & ", " | ", " ^ ",
+                                 " == ", " != ", " < ", " >= ", " && ",
+                                 " || "};
+
+const char *const Escapes[] = {"\\n", "\\t", "\\\\", "\\\"", "\\x41",
+                               "\\u00e9", "\\r", "\\0"};
+
+const char *const Words[] = {"the",  "lexer", "skips", "this", "comment",
+                             "text", "until", "its",   "end",  "marker"};
+
+std::vector<std::string> make_names(Random &random, const char *const *parts,
+                                    size_t part_count, size_t count) {
+  std::vector<std::string> names;
+  for (size_t i = 0; i < count; ++i) {
+    std::string name = parts[random.below(part_count)];
+    const size_t extra = random.below(3);
+    for (size_t j = 0; j < extra; ++j) {
+      name += '_';
+      name += parts[random.below(part_count)];
+    }
+    name += std::to_string(i);
+    names.push_back(std::move(name));
+  }
+  return names;
+}
+
+void append_number(Random &random, std::string &out) {
+  switch (random.below(4)) {
+  case 0:
+    out += std::to_string(random.below(100));
+    break;
+  case 1:
+    out += std::to_string(random.next());
+    break;
+  case 2: {
+    static const char Hex[] = "0123456789ABCDEF";
+    out += "0x";
+    for (size_t i = 1 + random.below(12); i > 0; --i) {
+      out += Hex[random.below(16)];
+    }
+    break;
+  }
+  default:
+    out += std::to_string(random.below(100000));
+    out += '.';
+    out += std::to_string(random.below(1000));
+    if (random.below(2) == 0) {
+      out += random.below(2) == 0 ? "e+" : "e-";
+      out += std::to_string(random.below(300));
+    }
+    break;
+  }
+}
+
+void append_string(Random &random, std::string &out) {
+  out += '"';
+  for (size_t i = 4 + random.below(12); i > 0; --i) {
+    if (random.below(3) == 0) {
+      out += random.pick(Escapes);
+    } else {
+      out += random.pick(Words);
+      out += ' ';
+    }
+  }
+  out += '"';
+}
+
+void append_comment(Random &random, std::string &out) {
+  const bool line = random.below(2) == 0;
+  out += line ? "// " : "/* ";
+  for (size_t i = 4 + random.below(16); i > 0; --i) {
+    out += random.pick(Words);
+    out += ' ';
+    if (!line && random.below(8) == 0) {
+      out += "*\n * ";
+    }
+  }
+  out += line ? "\n" : "*/\n";
+}
+
+} // namespace
+
+const char *Corpus::get_name(Kind kind) {
+  switch (kind) {
+  case Kind::Identifiers:
+    return "identifiers";
+  case Kind::Numerics:
+    return "numerics";
+  case Kind::Strings:
+    return "strings";
+  case Kind::Comments:
+    return "comments";
+  case Kind::Unicode:
+    return "unicode";
+  }
+  return "unknown";
+}
+
+std::string Corpus::generate(Kind kind, size_t size, uint64_t seed) {
+  Random random(seed ^ (static_cast<uint64_t>(kind) << 56));
+  const std::vector<std::string> names =
+      kind == Kind::Unicode
+          ? make_names(random, UnicodeParts, std::size(UnicodeParts), 4096)
+          : make_names(random, AsciiParts, std::size(AsciiParts), 4096);
+
+  auto operand = [&](std::string &out) {
+    switch (kind) {
+    case Kind::Numerics:
+      append_number(random, out);
+      break;
+    case Kind::Strings:
+      append_string(random, out);
+      break;
+    default:
+      out += names[random.below(names.size())];
+      break;
+    }
+  };
+
+  std::string out;
+  out.reserve(size + 256);
+  while (out.size() < size) {
+    if (kind == Kind::Comments) {
+      for (size_t i = 1 + random.below(3); i > 0; --i) {
+        append_comment(random, out);
+      }
+    }
+    out += "let ";
+    out += names[random.below(names.size())];
+    out += " = ";
+    operand(out);
+    for (size_t i = random.below(6); i > 0; --i) {
+      out += random.pick(Operators);
+      if (random.below(4) == 0) {
+        out += '(';
+        operand(out);
+        out += random.pick(Operators);
+        operand(out);
+        out += ')';
+      } else {
+        operand(out);
+      }
+    }
+    out += ";\n";
+  }
+  return out;
+}
@@ -0,0 +1,31 @@
+#ifndef MR_MRC_BENCH_CORPUS_H
+#define MR_MRC_BENCH_CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Synthetic mrc sources for benchmarking. Every corpus is a sequence of
+// statements that lexes and parses without errors, and the output depends
+// only on the kind, the size and the seed.
+class Corpus {
+public:
+  enum class Kind {
+    Identifiers,
+    Numerics,
+    Strings,
+    Comments,
+    Unicode,
+  };
+
+  static constexpr Kind Kinds[] = {Kind::Identifiers, Kind::Numerics,
+                                   Kind::Strings, Kind::Comments,
+                                   Kind::Unicode};
+
+  static const char *get_name(Kind kind);
+
+  // At least `size` bytes, ending on a statement boundary.
+  static std::string generate(Kind kind, size_t size, uint64_t seed = 0x6d7263);
+};
+
+#endif
@@ -0,0 +1,286 @@
+// Measures lexer and parser throughput on generated corpora and compares it
+// against a stored baseline.
+//
+// usage: mrc-bench [--output=results.json] [--baseline=baseline.json]
+//                  [--threshold=5] [--repetitions=5] [--filter=substring]
+
+#include "Corpus.h"
+
+#include "CharScan.h"
+#include "Interner.h"
+#include "Lexer.h"
+#include "Parser.h"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace cl = llvm::cl;
+
+static cl::opt<std::string>
+    OutputFile("output", cl::value_desc("file"),
+               cl::desc("Write the results as JSON to this file"));
+
+static cl::opt<std::string>
+    BaselineFile("baseline", cl::value_desc("file"),
+                 cl::desc("Compare against results from an earlier run"));
+
+static cl::opt<double>
+    Threshold("threshold", cl::init(5.0), cl::value_desc("percent"),
+              cl::desc("Slowdown against the baseline reported as a "
+                       "regression (default: 5)"));
+
+static cl::opt<unsigned>
+    Repetitions("repetitions", cl::init(5), cl::value_desc("N"),
+                cl::desc("Runs per measurement; the fastest is kept"));
+
+static cl::opt<std::string>
+    Filter("filter", cl::value_desc("substring"),
+           cl::desc("Only run benchmarks whose name contains this"));
+
+// Every allocation made through operator new, so that allocations per token
+// can be reported without an external profiler.
+static std::atomic<uint64_t> Allocations{0};
+
+void *operator new(size_t size) {
+  Allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size != 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return ::operator new(size); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+const size_t Sizes[] = {64 << 10, 1 << 20, 16 << 20};
+
+struct Result {
+  std::string name;
+  std::string phase;
+  uint64_t bytes = 0;
+  uint64_t tokens = 0;
+  double seconds = 0;
+  uint64_t allocations = 0;
+
+  double get_mb_per_s() const { return this->bytes / this->seconds / 1e6; }
+  double get_tokens_per_s() const { return this->tokens / this->seconds; }
+  double get_allocations_per_token() const {
+    return static_cast<double>(this->allocations) / this->tokens;
+  }
+};
+
+std::string get_size_name(size_t size) {
+  return size >= (1 << 20) ? std::to_string(size >> 20) + "MiB"
+                           : std::to_string(size >> 10) + "KiB";
+}
+
+// Runs `phase` Repetitions times on a fresh Interner each time, keeping the
+// fastest run.
+template <typename Phase>
+Result measure(std::string name, std::string phase_name,
+               const llvm::MemoryBuffer &buffer, uint64_t tokens,
+               Phase phase) {
+  Result result;
+  result.name = std::move(name);
+  result.phase = std::move(phase_name);
+  result.bytes = buffer.getBufferSize();
+  result.tokens = tokens;
+  for (unsigned i = 0; i < Repetitions; ++i) {
+    Interner interner;
+    const uint64_t allocations = Allocations.load(std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    phase(buffer.getBuffer(), interner);
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < result.seconds) {
+      result.seconds = elapsed.count();
+    }
+    result.allocations =
+        Allocations.load(std::memory_order_relaxed) - allocations;
+  }
+  return result;
+}
+
+// Number of tokens including Eof.
+uint64_t run_lexer(llvm::StringRef source, Interner &interner) {
+  Lexer lexer(source, interner);
+  uint64_t tokens = 1;
+  while (lexer.next().kind != TokenKind::Eof) {
+    ++tokens;
+  }
+  return tokens;
+}
+
+// The parser pulls its tokens, so this phase includes lexing.
+void run_parser(llvm::StringRef source, Interner &interner) {
+  Lexer lexer(source, interner);
+  Parser parser(lexer);
+  parser.parse();
+  if (parser.get_error() != ParserErrorCode::NoError) {
+    llvm::errs() << "corpus failed to parse at byte "
+                 << parser.get_error_offset() << "\n";
+    std::exit(2);
+  }
+}
+
+llvm::json::Value to_json(const Result &result) {
+  return llvm::json::Object{
+      {"name", result.name},
+      {"phase", result.phase},
+      {"bytes", static_cast<int64_t>(result.bytes)},
+      {"tokens", static_cast<int64_t>(result.tokens)},
+      {"seconds", result.seconds},
+      {"mb_per_s", result.get_mb_per_s()},
+      {"tokens_per_s", result.get_tokens_per_s()},
+      {"allocations_per_token", result.get_allocations_per_token()},
+  };
+}
+
+// Baseline throughput by "name/phase".
+bool load_baseline(llvm::StringRef path, llvm::StringMap<double> &baseline) {
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> file =
+      llvm::MemoryBuffer::getFile(path);
+  if (!file) {
+    llvm::errs() << "Error opening \"" << path
+                 << "\": " << file.getError().message() << "\n";
+    return false;
+  }
+  llvm::Expected<llvm::json::Value> json =
+      llvm::json::parse((*file)->getBuffer());
+  if (!json) {
+    llvm::errs() << "Error reading \"" << path
+                 << "\": " << llvm::toString(json.takeError()) << "\n";
+    return false;
+  }
+  const llvm::json::Object *root = json->getAsObject();
+  const llvm::json::Array *results =
+      root != nullptr ? root->getArray("results") : nullptr;
+  if (results == nullptr) {
+    llvm::errs() << "Error reading \"" << path << "\": no results array\n";
+    return false;
+  }
+  for (const llvm::json::Value &value : *results) {
+    const llvm::json::Object *result = value.getAsObject();
+    if (result == nullptr) {
+      continue;
+    }
+    auto name = result->getString("name");
+    auto phase = result->getString("phase");
+    auto mb_per_s = result->getNumber("mb_per_s");
+    if (name && phase && mb_per_s) {
+      baseline[(*name + "/" + *phase).str()] = *mb_per_s;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  llvm::InitLLVM init(argc, argv);
+  cl::ParseCommandLineOptions(argc, argv, "mrc frontend benchmarks\n");
+
+  llvm::StringMap<double> baseline;
+  if (!BaselineFile.empty() && !load_baseline(BaselineFile, baseline)) {
+    return 1;
+  }
+
+  std::printf("kernels: %s\n", CharScan::get_isa());
+  std::printf("%-24s %-6s %10s %12s %12s %9s\n", "benchmark", "phase", "MB/s",
+              "tokens/s", "allocs/tok", "vs base");
+
+  std::vector<Result> results;
+  bool regressed = false;
+  for (Corpus::Kind kind : Corpus::Kinds) {
+    for (size_t size : Sizes) {
+      const std::string name =
+          std::string(Corpus::get_name(kind)) + "/" + get_size_name(size);
+      if (!Filter.empty() && name.find(Filter) == std::string::npos) {
+        continue;
+      }
+      // Lexer input must end with the '\0' sentinel MemoryBuffer provides.
+      std::unique_ptr<llvm::MemoryBuffer> buffer =
+          llvm::MemoryBuffer::getMemBufferCopy(Corpus::generate(kind, size),
+                                               name);
+
+      uint64_t tokens;
+      {
+        Interner interner;
+        tokens = run_lexer(buffer->getBuffer(), interner);
+      }
+
+      for (Result result :
+           {measure(name, "lex", *buffer, tokens, run_lexer),
+            measure(name, "parse", *buffer, tokens, run_parser)}) {
+        std::string delta = "-";
+        auto base = baseline.find(result.name + "/" + result.phase);
+        if (base != baseline.end()) {
+          const double change =
+              (result.get_mb_per_s() / base->second - 1) * 100;
+          char text[32];
+          std::snprintf(text, sizeof(text), "%+.1f%%", change);
+          delta = text;
+          if (change < -Threshold) {
+            delta += " !";
+            regressed = true;
+          }
+        }
+        std::printf("%-24s %-6s %10.1f %12.0f %12.3f %9s\n",
+                    result.name.c_str(), result.phase.c_str(),
+                    result.get_mb_per_s(), result.get_tokens_per_s(),
+                    result.get_allocations_per_token(), delta.c_str());
+        results.push_back(std::move(result));
+      }
+    }
+  }
+
+  if (!OutputFile.empty()) {
+    llvm::json::Array array;
+    for (const Result &result : results) {
+      array.push_back(to_json(result));
+    }
+    std::error_code error;
+    llvm::raw_fd_ostream os(OutputFile, error);
+    if (error) {
+      llvm::errs() << "Error opening \"" << OutputFile
+                   << "\": " << error.message() << "\n";
+      return 1;
+    }
+    os << llvm::formatv(
+        "{0:2}\n", llvm::json::Value(llvm::json::Object{
+                       {"kernels", CharScan::get_isa()},
+                       {"results", std::move(array)},
+                   }));
+  }
+
+  if (regressed) {
+    std::printf("regression: throughput fell more than %.1f%% below the "
+                "baseline\n",
+                Threshold.getValue());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Compares the per-code-point cost of the generated identifier tables in
+// LexerUtil against the range chains they replaced.
+//
+// usage: mrc-unicode-bench [iterations]
+
+#include "LexerUtil.h"
+#include "LegacyLexerUtil.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+struct Sample {
+  const char *name;
+  uint32_t lo;
+  uint32_t hi;
+};
+
+static const Sample Samples[] = {
+    {"ascii", 0x21, 0x7E},
+    {"latin", 0x80, 0x24F},
+    {"greek+cyrillic", 0x370, 0x4FF},
+    {"cjk", 0x4E00, 0x9FFF},
+    {"bmp", 0x80, 0xFFFF},
+};
+
+static bool legacy_start(uint32_t cp) {
+  return cp == '$' || cp == '_' || LegacyLexerUtil::is_unicode_char(cp);
+}
+
+static bool legacy_continue(uint32_t cp) {
+  return legacy_start(cp) || LegacyLexerUtil::is_unicode_digit(cp) ||
+         LegacyLexerUtil::is_unicode_punc(cp);
+}
+
+template <typename Fn>
+static double ns_per_code_point(const std::vector<uint32_t> &input,
+                                unsigned iterations, Fn classify) {
+  size_t hits = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < iterations; ++i) {
+    for (uint32_t cp : input) {
+      hits += classify(cp);
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  // Keep the loop from being optimized away.
+  volatile size_t sink = hits;
+  (void)sink;
+  const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+  return ns / (double(input.size()) * iterations);
+}
+
+int main(int argc, char *argv[]) {
+  const unsigned iterations = argc > 1 ? std::atoi(argv[1]) : 200;
+  std::mt19937 rng(0x6d72);
+
+  std::printf("%-16s %10s %10s %10s %10s %8s %8s\n", "sample", "start.old",
+              "start.new", "cont.old", "cont.new", "diff.s", "diff.c");
+  for (const Sample &sample : Samples) {
+    std::uniform_int_distribution<uint32_t> dist(sample.lo, sample.hi);
+    std::vector<uint32_t> input(1 << 16);
+    for (uint32_t &cp : input) {
+      cp = dist(rng);
+    }
+
+    size_t start_diff = 0, continue_diff = 0;
+    for (uint32_t cp = sample.lo; cp <= sample.hi; ++cp) {
+      start_diff += legacy_start(cp) != LexerUtil::is_id_start(cp);
+      continue_diff += legacy_continue(cp) != LexerUtil::is_id_continue(cp);
+    }
+
+    std::printf(
+        "%-16s %8.2fns %8.2fns %8.2fns %8.2fns %8zu %8zu\n", sample.name,
+        ns_per_code_point(input, iterations, legacy_start),
+        ns_per_code_point(input, iterations, LexerUtil::is_id_start),
+        ns_per_code_point(input, iterations, legacy_continue),
+        ns_per_code_point(input, iterations, LexerUtil::is_id_continue),
+        start_diff, continue_diff);
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Generates the powers of five used by NumberUtil to convert decimal literals.
+
+Each entry is 5^q for q in [MIN_EXPONENT, MAX_EXPONENT] as a 128-bit value
+normalized so that its top bit is set, split into high and low 64-bit words.
+Positive powers are truncated; negative powers are the reciprocal rounded up
+(Eisel-Lemire, see "Number Parsing at a Gigabyte per Second", Lemire 2021).
+"""
+
+import argparse
+
+MIN_EXPONENT = -342
+MAX_EXPONENT = 308
+
+
+def power(q):
+    if q >= 0:
+        value = 5**q
+        while value < (1 << 127):
+            value <<= 1
+        while value >= (1 << 128):
+            value >>= 1
+        return value
+    divisor = 5**-q
+    bits = divisor.bit_length()
+    # Reciprocals of small powers are exact enough at 128 bits; larger ones
+    # are computed with more precision and truncated back.
+    if q >= -27:
+        return (1 << (bits + 127)) // divisor + 1
+    value = (1 << (2 * bits + 128)) // divisor + 1
+    while value >= (1 << 128):
+        value >>= 1
+    return value
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    mask = (1 << 64) - 1
+    out = [
+        "// Generated by gen_pow5_table.py. Do not edit.",
+        "",
+        f"static constexpr int Pow5MinExponent = {MIN_EXPONENT};",
+        f"static constexpr int Pow5MaxExponent = {MAX_EXPONENT};",
+        f"static constexpr uint64_t Pow5Table[{MAX_EXPONENT - MIN_EXPONENT + 1}][2] = {{",
+    ]
+    for q in range(MIN_EXPONENT, MAX_EXPONENT + 1):
+        value = power(q)
+        out.append(f"    {{0x{value >> 64:016x}, 0x{value & mask:016x}}}, // 5^{q}")
+    out.append("};")
+    out.append("")
+
+    with open(args.output, "w", encoding="utf-8") as inc:
+        inc.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Generates the identifier tables used by LexerUtil.
+
+Each property is stored as a two-level bitmap: a stage-1 index from the high
+bits of the code point (cp >> 8) to a deduplicated 256-bit block, and the
+blocks themselves as four 64-bit words. ASCII gets a separate 128-bit mask so
+the lexer can classify it without touching the large tables.
+
+XID_Start and XID_Continue are read from DerivedCoreProperties.txt when
+--ucd is given, and from Python's own unicodedata database otherwise
+(str.isidentifier() is defined in terms of the same properties). The
+output is checked in as UnicodeTables.inc and records the Unicode version it
+was generated from, which the build reads back for the compiler hashes; it
+is only regenerated on request (the mrc-regenerate-unicode-tables target).
+--unicode-version rejects a source of any other version.
+"""
+
+import argparse
+import os
+import re
+import sys
+import unicodedata
+
+MAX_CODE_POINT = 0x10FFFF
+BLOCK_BITS = 8
+BLOCK_SIZE = 1 << BLOCK_BITS
+STAGE1_SIZE = (MAX_CODE_POINT >> BLOCK_BITS) + 1
+
+
+def ucd_version(path):
+    # The first line names the file, e.g. "# DerivedCoreProperties-15.0.0.txt".
+    with open(path, encoding="utf-8") as ucd:
+        match = re.match(r"#\s*DerivedCoreProperties-([\d.]+)\.txt", ucd.readline())
+    return match.group(1) if match else None
+
+
+def from_ucd(path):
+    props = {"XID_Start": set(), "XID_Continue": set()}
+    with open(path, encoding="utf-8") as ucd:
+        for line in ucd:
+            line = line.split("#", 1)[0].strip()
+            if not line:
+                continue
+            cps, prop = (field.strip() for field in line.split(";")[:2])
+            if prop not in props:
+                continue
+            lo, _, hi = cps.partition("..")
+            props[prop].update(range(int(lo, 16), int(hi or lo, 16) + 1))
+    return props["XID_Start"], props["XID_Continue"]
+
+
+def from_python():
+    start, cont = set(), set()
+    for cp in range(MAX_CODE_POINT + 1):
+        if 0xD800 <= cp <= 0xDFFF:
+            continue
+        ch = chr(cp)
+        if ch.isidentifier() and ch != "_":
+            start.add(cp)
+        if ("a" + ch).isidentifier():
+            cont.add(cp)
+    return start, cont
+
+
+def bitmap(members, lo, hi):
+    words = [0] * ((hi - lo + 63) // 64)
+    for cp in range(lo, hi):
+        if cp in members:
+            words[(cp - lo) >> 6] |= 1 << ((cp - lo) & 63)
+    return words
+
+
+def emit_property(out, name, members, ascii_extra):
+    ascii_words = bitmap(members | ascii_extra, 0, 128)
+    blocks, index = [], []
+    seen = {}
+    for hi in range(STAGE1_SIZE):
+        block = tuple(bitmap(members, hi * BLOCK_SIZE, (hi + 1) * BLOCK_SIZE))
+        if block not in seen:
+            seen[block] = len(blocks)
+            blocks.append(block)
+        index.append(seen[block])
+    if len(blocks) > 256:
+        sys.exit(f"{name}: {len(blocks)} unique blocks do not fit uint8_t")
+
+    out.append(f"inline constexpr uint64_t {name}Ascii[2] = {{")
+    out.append("    " + ", ".join(f"0x{w:016x}" for w in ascii_words) + "};")
+    out.append(f"inline constexpr uint8_t {name}Index[{STAGE1_SIZE}] = {{")
+    for row in range(0, len(index), 16):
+        out.append("    " + ", ".join(str(i) for i in index[row:row + 16]) + ",")
+    out.append("};")
+    out.append(f"inline constexpr uint64_t {name}Blocks[{len(blocks)}][4] = {{")
+    for block in blocks:
+        out.append("    {" + ", ".join(f"0x{w:016x}" for w in block) + "},")
+    out.append("};")
+    out.append("")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output")
+    parser.add_argument("--ucd", help="path to DerivedCoreProperties.txt")
+    parser.add_argument("--unicode-version",
+                        help="Unicode version the source must have")
+    args = parser.parse_args()
+
+    if args.ucd:
+        version = ucd_version(args.ucd)
+        source = os.path.basename(args.ucd)
+    else:
+        version = unicodedata.unidata_version
+        source = "Python unicodedata"
+    if version is None:
+        sys.exit(f"{source} does not name its Unicode version")
+    if args.unicode_version and version != args.unicode_version:
+        sys.exit(f"{source} is Unicode {version}, not the pinned "
+                 f"{args.unicode_version}; pass the DerivedCoreProperties.txt "
+                 f"of Unicode {args.unicode_version} as MRC_UCD_FILE")
+    if args.ucd:
+        start, cont = from_ucd(args.ucd)
+    else:
+        start, cont = from_python()
+
+    # '$' and '_' may start and continue identifiers in Metareal.
+    extra = {ord("$"), ord("_")}
+
+    out = [
+        "// Generated by gen_unicode_tables.py. Do not edit.",
+        f"// Source: {source}, Unicode {version}",
+        "",
+    ]
+    emit_property(out, "IdStart", start, extra)
+    emit_property(out, "IdContinue", cont, extra)
+
+    with open(args.output, "w", encoding="utf-8") as inc:
+        inc.write("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()